@@ -19,80 +19,87 @@ along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
 #include <cstdlib>
 #include "atomcache.h"
 #include <QX11Info>
+#include <QVector>
+#include <QMutexLocker>
 #include <QDebug>
 
-class AtomNode
-{
-public:
-    AtomNode() : name("NONE"), atom(0) { }
-    AtomNode(const QString &new_name, xcb_atom_t new_atom) : name(new_name), atom(new_atom) { }
-    QString name;
-    xcb_atom_t atom;
-};
-
 xcb_connection_t *AtomCache::connection(nullptr);
-QList<AtomNode> AtomCache::atom_cache;
+QMutex AtomCache::mutex;
+QHash<QString, xcb_atom_t> AtomCache::atoms_by_name;
+QHash<xcb_atom_t, QString> AtomCache::names_by_atom;
 
 xcb_atom_t AtomCache::GetAtom(const QString &name) {
-    QList<AtomNode>::iterator p;
     xcb_atom_t ret = XCB_ATOM_NONE;
     xcb_intern_atom_cookie_t atom_cookie;
     xcb_intern_atom_reply_t *atom_reply;
-    //xcb_connection_t *connection = QX11Info::connection();
+    QMutexLocker locker(&mutex);
     if (!connection) connection = QX11Info::connection();
     xcb_generic_error_t *err = nullptr;
 
-    for (p = atom_cache.begin(); p != atom_cache.end(); ++p) {
-        if (name == p->name) {
-            ret = p->atom;
-            break;
-        }
-    }
-    if (ret == XCB_ATOM_NONE) {
-        QByteArray utf8Name = name.toUtf8();
-        atom_cookie = xcb_intern_atom(connection, 0, utf8Name.length(), utf8Name.constData());
-        //qDebug() << "request atom " << utf8Name;
-        if ((atom_reply = xcb_intern_atom_reply(connection, atom_cookie, &err))) {
-            //qDebug() << "atom reply " << atom_reply->atom;
-            if (err) qDebug() << "AtomCache::GetAtom: XCB Error: " << err->error_code;
-            if (err) free(err);
-            ret = atom_reply->atom;
-            atom_cache.append(AtomNode(name, ret));
-            free(atom_reply);
-        }
+    QHash<QString, xcb_atom_t>::const_iterator p = atoms_by_name.constFind(name);
+    if (p != atoms_by_name.constEnd()) return p.value();
+    QByteArray utf8Name = name.toUtf8();
+    atom_cookie = xcb_intern_atom(connection, 0, utf8Name.length(), utf8Name.constData());
+    if ((atom_reply = xcb_intern_atom_reply(connection, atom_cookie, &err))) {
+        ret = atom_reply->atom;
+        Insert(name, ret);
+        free(atom_reply);
     }
+    if (err) qDebug() << "AtomCache::GetAtom: XCB Error: " << err->error_code;
+    if (err) free(err);
     return ret;
 }
 
 QString AtomCache::GetAtomName(xcb_atom_t atom) {
-    QList<AtomNode>::iterator p;
     QString ret;
     int name_len;
     xcb_get_atom_name_cookie_t atom_cookie;
     xcb_get_atom_name_reply_t *atom_reply;
-    //xcb_connection_t *connection = QX11Info::connection();
+    QMutexLocker locker(&mutex);
     if (!connection) connection = QX11Info::connection();
     xcb_generic_error_t *err = nullptr;
 
-    for (p = atom_cache.begin(); p != atom_cache.end(); ++p) {
-        if (atom == p->atom) {
-            ret = p->name;
-            break;
-        }
+    QHash<xcb_atom_t, QString>::const_iterator p = names_by_atom.constFind(atom);
+    if (p != names_by_atom.constEnd()) return p.value();
+    atom_cookie = xcb_get_atom_name(connection, atom);
+    if ((atom_reply = xcb_get_atom_name_reply(connection, atom_cookie, &err))) {
+        name_len = xcb_get_atom_name_name_length(atom_reply);
+        const char *name_cstr = xcb_get_atom_name_name(atom_reply);
+        ret = QString::fromUtf8(name_cstr, name_len);
+        Insert(ret, atom);
+        free(atom_reply);
+    }
+    if (err) qDebug() << "AtomCache::GetAtomName: XCB Error: " << err->error_code;
+    if (err) free(err);
+    return ret;
+}
+
+void AtomCache::Preload(const QStringList &names) {
+    // send every intern_atom request before waiting on any of the replies so
+    // the whole list costs one round trip instead of one per atom
+    QMutexLocker locker(&mutex);
+    if (!connection) connection = QX11Info::connection();
+    QStringList pending_names;
+    QVector<xcb_intern_atom_cookie_t> cookies;
+    for (const QString &name : names) {
+        if (atoms_by_name.contains(name) || pending_names.contains(name)) continue;
+        QByteArray utf8Name = name.toUtf8();
+        pending_names.append(name);
+        cookies.append(xcb_intern_atom(connection, 0, utf8Name.length(), utf8Name.constData()));
     }
-    if (ret.isEmpty()) {
-        atom_cookie = xcb_get_atom_name(connection, atom);
-        if ((atom_reply = xcb_get_atom_name_reply(connection, atom_cookie, &err))) {
-            if (err) qDebug() << "AtomCache::GetAtomName: XCB Error: " << err->error_code;
-            if (err) free(err);
-            name_len = xcb_get_atom_name_name_length(atom_reply);
-            const char *name_cstr = xcb_get_atom_name_name(atom_reply);
-            ret = QString::fromUtf8(name_cstr, name_len);
-            atom_cache.append(AtomNode(ret, atom));
+    for (int i = 0; i < cookies.count(); ++i) {
+        xcb_generic_error_t *err = nullptr;
+        xcb_intern_atom_reply_t *atom_reply = xcb_intern_atom_reply(connection, cookies.at(i), &err);
+        if (atom_reply) {
+            Insert(pending_names.at(i), atom_reply->atom);
             free(atom_reply);
         }
+        if (err) qDebug() << "AtomCache::Preload: XCB Error: " << err->error_code << pending_names.at(i);
+        if (err) free(err);
     }
-    return ret;
 }
 
-
+void AtomCache::Insert(const QString &name, xcb_atom_t atom) {
+    atoms_by_name.insert(name, atom);
+    if (atom != XCB_ATOM_NONE) names_by_atom.insert(atom, name);
+}
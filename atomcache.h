@@ -21,21 +21,26 @@ along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <xcb/xcb.h>
 #include <QString>
-#include <QList>
-
-class AtomNode;
+#include <QStringList>
+#include <QHash>
+#include <QMutex>
 
+// Runtime atom lookups.  The atoms known at compile time live in EwmhAtoms.
 class AtomCache
 {
 public:
     static xcb_atom_t GetAtom(const QString &name);
     static QString GetAtomName(xcb_atom_t atom);
+    static void Preload(const QStringList &names);
 
 private:
     AtomCache() {}
     ~AtomCache() {}
+    static void Insert(const QString &name, xcb_atom_t atom);
     static xcb_connection_t *connection;
-    static QList<AtomNode> atom_cache;
+    static QMutex mutex;
+    static QHash<QString, xcb_atom_t> atoms_by_name;
+    static QHash<xcb_atom_t, QString> names_by_atom;
 };
 
 #endif // ATOMCACHE_H
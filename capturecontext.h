@@ -0,0 +1,48 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef CAPTURECONTEXT_H
+#define CAPTURECONTEXT_H
+
+#include <xcb/xcb.h>
+
+class ShmCapture;
+class RenderScaler;
+
+// The per-connection half of capturing a window: the connection itself plus
+// the shm segment and render formats that belong to it.  Every capture
+// worker has one on its own connection.  Only ever used by one thread at a
+// time.
+class CaptureContext
+{
+public:
+    // doesn't take c over; whoever opened it closes it after this is gone
+    explicit CaptureContext(xcb_connection_t *c);
+    ~CaptureContext();
+    xcb_connection_t *Connection() const { return connection; }
+    // both made the first time they're wanted
+    ShmCapture *Shm();
+    RenderScaler *Render();
+
+private:
+    xcb_connection_t *connection;
+    ShmCapture *shm;
+    RenderScaler *render;
+};
+
+#endif // CAPTURECONTEXT_H
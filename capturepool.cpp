@@ -0,0 +1,238 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "capturepool.h"
+#include "capturecontext.h"
+#include "logcategories.h"
+#include "xcbeventfilter.h"
+#include <QThreadPool>
+#include <QThreadStorage>
+#include <QThread>
+#include <QRunnable>
+#include <QMetaObject>
+#include <QDebug>
+
+// each one holds an X connection and an shm segment, so not too many
+#define CAPTURE_WORKERS 2
+// how often the queue statistics get logged, in captures
+#define CAPTURE_REPORT_EVERY 100
+
+namespace
+{
+    // what a worker thread keeps for as long as it lives
+    struct worker
+    {
+        worker() : connection(nullptr), ctx(nullptr) { }
+        ~worker()
+        {
+            delete ctx;
+            if (connection) xcb_disconnect(connection);
+        }
+        xcb_connection_t *connection;
+        CaptureContext *ctx;
+    };
+
+    QThreadStorage<worker *> workers;
+
+    CaptureContext *WorkerContext()
+    {
+        if (workers.hasLocalData()) return workers.localData()->ctx;
+        worker *w = new worker;
+        workers.setLocalData(w);
+        // first job on this thread: get out of everyone's way, then connect
+        QThread::currentThread()->setPriority(QThread::IdlePriority);
+        w->connection = xcb_connect(nullptr, nullptr);
+        if (xcb_connection_has_error(w->connection))
+        {
+            qDebug() << "CapturePool: worker couldn't open a connection to the X server";
+            return nullptr;
+        }
+        w->ctx = new CaptureContext(w->connection);
+        return w->ctx;
+    }
+
+    // nobody else reads a worker's connection, so whatever it queued up has
+    // to be taken off it here or it piles up.  errors from the last few
+    // requests may still be on their way; they're picked up after the next job.
+    void DrainEvents(xcb_connection_t *c)
+    {
+        while (xcb_generic_event_t *ev = xcb_poll_for_event(c))
+        {
+            if (ev->response_type == 0)
+            {
+                xcb_generic_error_t *err = (xcb_generic_error_t *)ev;
+                xcbEventFilter::errorHandler("CapturePool: ", &err);
+            }
+            else free(ev);
+        }
+    }
+}
+
+class CapturePool::Job : public QRunnable
+{
+public:
+    Job(CapturePool *p, xcb_window_t w, const request &r, const QSharedPointer<QAtomicInt> &c) :
+        owner(p), win(w), generation(r.generation), content(r.content), icon_size(r.icon_size), info(r.info), cancelled(c) { }
+    void run() override
+    {
+        QImage icon;
+        WinInfo::IconFetch icons;
+        // a window destroyed while this was waiting for a thread isn't worth capturing
+        if (!cancelled->load())
+        {
+            if (CaptureContext *ctx = WorkerContext())
+            {
+                icon = info.CaptureIcon(*ctx, icon_size, &icons);
+                DrainEvents(ctx->Connection());
+            }
+        }
+        QMetaObject::invokeMethod(owner, "Deliver", Qt::QueuedConnection, Q_ARG(uint, win), Q_ARG(uint, generation),
+                                  Q_ARG(uint, content), Q_ARG(int, icon_size), Q_ARG(QImage, icon), Q_ARG(WinInfo::IconFetch, icons));
+    }
+
+private:
+    CapturePool *owner;
+    xcb_window_t win;
+    quint32 generation, content;
+    int icon_size;
+    WinInfo info;
+    QSharedPointer<QAtomicInt> cancelled;
+};
+
+CapturePool::CapturePool(QObject *parent) :
+    QObject(parent), next_order(0), dispatched(0), merged(0), cancelled(0),
+    wait_total(0), wait_max(0), depth_max(0)
+{
+    qRegisterMetaType<WinInfo::IconFetch>("WinInfo::IconFetch");
+    pool = new QThreadPool(this);
+    pool->setMaxThreadCount(CAPTURE_WORKERS);
+    // threads (and their connections) stay until we're gone
+    pool->setExpiryTimeout(-1);
+    clock.start();
+}
+
+CapturePool::~CapturePool()
+{
+    // anything still running delivers to us, so wait it out.  the results
+    // are queued and get thrown away with us.
+    queue.clear();
+    pool->waitForDone();
+}
+
+void CapturePool::Request(xcb_window_t win, quint32 generation, quint32 content, int icon_size, const WinInfo &info, Priority priority)
+{
+    // already being made, so queueing it again would only capture it twice
+    QHash<xcb_window_t, in_flight>::const_iterator r = running.constFind(win);
+    if (r != running.constEnd() && r.value().generation == generation && r.value().content == content &&
+        r.value().icon_size == icon_size && !r.value().cancelled->load())
+    {
+        ++merged;
+        return;
+    }
+    QHash<xcb_window_t, request>::iterator it = queue.find(win);
+    if (it != queue.end())
+    {
+        // the newest request says what's wanted; the oldest says how long
+        // it's been wanted
+        ++merged;
+        request &r = it.value();
+        r.generation = generation;
+        r.content = content;
+        r.icon_size = icon_size;
+        r.info = info;
+        if (priority < r.priority) r.priority = priority;
+    }
+    else
+    {
+        request r;
+        r.generation = generation;
+        r.content = content;
+        r.icon_size = icon_size;
+        r.info = info;
+        r.priority = priority;
+        r.queued_at = clock.elapsed();
+        r.order = next_order++;
+        queue.insert(win, r);
+        if (queue.count() > depth_max) depth_max = queue.count();
+    }
+    Dispatch();
+}
+
+void CapturePool::Cancel(xcb_window_t win)
+{
+    if (queue.remove(win)) ++cancelled;
+    QHash<xcb_window_t, in_flight>::iterator it = running.find(win);
+    if (it != running.end() && !it.value().cancelled->load())
+    {
+        it.value().cancelled->store(1);
+        ++cancelled;
+    }
+}
+
+bool CapturePool::IsWanted(xcb_window_t win, quint32 content) const
+{
+    QHash<xcb_window_t, request>::const_iterator q = queue.constFind(win);
+    if (q != queue.constEnd() && q.value().content == content) return true;
+    QHash<xcb_window_t, in_flight>::const_iterator r = running.constFind(win);
+    return r != running.constEnd() && r.value().content == content && !r.value().cancelled->load();
+}
+
+void CapturePool::Dispatch()
+{
+    while (running.count() < CAPTURE_WORKERS && !queue.isEmpty())
+    {
+        // most urgent first, then first come first served.  windows already
+        // being captured wait their turn so they're never done twice at once.
+        QHash<xcb_window_t, request>::iterator best = queue.end();
+        for (QHash<xcb_window_t, request>::iterator it = queue.begin(); it != queue.end(); ++it)
+        {
+            if (running.contains(it.key())) continue;
+            if (best == queue.end() || it.value().priority < best.value().priority ||
+                (it.value().priority == best.value().priority && it.value().order < best.value().order)) best = it;
+        }
+        if (best == queue.end()) return;
+        xcb_window_t win = best.key();
+        request r = best.value();
+        queue.erase(best);
+        qint64 wait = clock.elapsed() - r.queued_at;
+        wait_total += wait;
+        if (wait > wait_max) wait_max = wait;
+        in_flight f;
+        f.generation = r.generation;
+        f.content = r.content;
+        f.icon_size = r.icon_size;
+        f.cancelled = QSharedPointer<QAtomicInt>(new QAtomicInt(0));
+        running.insert(win, f);
+        pool->start(new Job(this, win, r, f.cancelled));
+        if (!(++dispatched % CAPTURE_REPORT_EVERY))
+        {
+            qCDebug(lcStats) << "CapturePool:" << dispatched << "captures," << merged << "merged," << cancelled << "cancelled; queue depth"
+                             << queue.count() << "(max" << depth_max << "), wait" << AverageWait() << "msec average," << wait_max << "msec max";
+        }
+    }
+}
+
+void CapturePool::Deliver(uint win, uint generation, uint content, int icon_size, const QImage &icon, const WinInfo::IconFetch &icons)
+{
+    QHash<xcb_window_t, in_flight>::iterator it = running.find(win);
+    bool wanted = (it != running.end() && !it.value().cancelled->load());
+    if (it != running.end()) running.erase(it);
+    // a free worker first, then whoever's waiting on this
+    Dispatch();
+    if (wanted) emit IconReady(win, generation, content, icon_size, icon, icons);
+}
@@ -0,0 +1,114 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef CAPTUREPOOL_H
+#define CAPTUREPOOL_H
+
+#include <QObject>
+#include <QImage>
+#include <QHash>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <xcb/xcb.h>
+#include "wininfo.h"
+
+class QThreadPool;
+
+// Makes icons off the gui thread.  Each worker has its own connection to
+// the server and runs at idle priority, so fetching, converting and scaling
+// a big window neither blocks the icon box nor competes with anything the
+// user is actually doing.  Finished icons come back through IconReady() on
+// the gui thread, tagged with whatever the caller asked for them with so it
+// can tell if they're still wanted.
+//
+// Requests wait in a queue that holds at most one per window: asking again
+// replaces what was asked for and keeps the more urgent priority.  A window
+// is never being captured twice at once, and the most urgent, then oldest,
+// request goes to the next free worker.
+class CapturePool : public QObject
+{
+    Q_OBJECT
+public:
+    enum Priority
+    {
+        // a window that was just iconified and has nothing to show yet
+        PRIORITY_ICONIFIED,
+        // an icon that's on screen but out of date
+        PRIORITY_VISIBLE,
+        // snapshots of windows that are still mapped
+        PRIORITY_BACKGROUND
+    };
+    explicit CapturePool(QObject *parent = nullptr);
+    ~CapturePool();
+    // info is copied; the window's pixmap is read through its id, which
+    // works from any connection.  asking for what a worker is already
+    // capturing does nothing.
+    void Request(xcb_window_t win, quint32 generation, quint32 content, int icon_size, const WinInfo &info, Priority priority);
+    // forgets the window's queued request and throws away whatever a worker
+    // is still doing for it
+    void Cancel(xcb_window_t win);
+    // whether a capture of these contents is queued or running
+    bool IsWanted(xcb_window_t win, quint32 content) const;
+    // requests that haven't come back yet
+    int Pending() const { return queue.count() + running.count(); }
+    int QueueDepth() const { return queue.count(); }
+    int MaxQueueDepth() const { return depth_max; }
+    // how long requests sat in the queue before a worker took them, in msec
+    qint64 AverageWait() const { return dispatched ? wait_total / (qint64)dispatched : 0; }
+    qint64 MaxWait() const { return wait_max; }
+
+signals:
+    // icons is what the capture learned about the window's own icons, for
+    // WinInfo::KeepIcons()
+    void IconReady(xcb_window_t win, quint32 generation, quint32 content, int icon_size, const QImage &icon, const WinInfo::IconFetch &icons);
+
+private slots:
+    // the workers hand results over through this, queued, so plain types only
+    void Deliver(uint win, uint generation, uint content, int icon_size, const QImage &icon, const WinInfo::IconFetch &icons);
+
+private:
+    class Job;
+    struct request
+    {
+        quint32 generation, content;
+        int icon_size;
+        WinInfo info;
+        Priority priority;
+        // when it was first asked for, and a tie breaker
+        qint64 queued_at;
+        quint64 order;
+    };
+    struct in_flight
+    {
+        quint32 generation, content;
+        int icon_size;
+        QSharedPointer<QAtomicInt> cancelled;
+    };
+    void Dispatch();
+    QThreadPool *pool;
+    QHash<xcb_window_t, request> queue;
+    QHash<xcb_window_t, in_flight> running;
+    QElapsedTimer clock;
+    quint64 next_order;
+    quint64 dispatched, merged, cancelled;
+    qint64 wait_total, wait_max;
+    int depth_max;
+};
+
+#endif // CAPTUREPOOL_H
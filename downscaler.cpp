@@ -0,0 +1,351 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "downscaler.h"
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QVector>
+#include <QtGlobal>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DOWNSCALER_X86 1
+#include <immintrin.h>
+#endif
+
+// don't bother with threads for anything smaller than this many source pixels
+#define DOWNSCALER_STRIP_THRESHOLD (1024 * 1024)
+
+namespace {
+
+// adds up each channel of n pixels into acc, which is in b, g, r, a order
+typedef void (*sum_span_fn)(const quint32 *px, int n, quint32 acc[4]);
+
+void SumSpanScalar(const quint32 *px, int n, quint32 acc[4])
+{
+    quint32 b = 0, g = 0, r = 0, a = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        QRgb p = px[i];
+        b += qBlue(p);
+        g += qGreen(p);
+        r += qRed(p);
+        a += qAlpha(p);
+    }
+    acc[0] += b;
+    acc[1] += g;
+    acc[2] += r;
+    acc[3] += a;
+}
+
+#ifdef DOWNSCALER_X86
+// the simd versions lean on the byte order of a little endian QRgb: b, g, r, a
+
+__attribute__((target("sse2")))
+void SumSpanSse2(const quint32 *px, int n, quint32 acc[4])
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i p = _mm_loadu_si128((const __m128i *)(px + i));
+        // two pixels per half, widened to 16 bits, then the halves added
+        __m128i s16 = _mm_add_epi16(_mm_unpacklo_epi8(p, zero), _mm_unpackhi_epi8(p, zero));
+        sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(s16, zero));
+        sum = _mm_add_epi32(sum, _mm_unpackhi_epi16(s16, zero));
+    }
+    quint32 lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, sum);
+    for (int c = 0; c < 4; ++c) acc[c] += lanes[c];
+    if (i < n) SumSpanScalar(px + i, n - i, acc);
+}
+
+__attribute__((target("avx2")))
+void SumSpanAvx2(const quint32 *px, int n, quint32 acc[4])
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sum = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i p = _mm256_loadu_si256((const __m256i *)(px + i));
+        // same as the sse2 one, just two 128 bit lanes at a time
+        __m256i s16 = _mm256_add_epi16(_mm256_unpacklo_epi8(p, zero), _mm256_unpackhi_epi8(p, zero));
+        sum = _mm256_add_epi32(sum, _mm256_unpacklo_epi16(s16, zero));
+        sum = _mm256_add_epi32(sum, _mm256_unpackhi_epi16(s16, zero));
+    }
+    __m128i folded = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    quint32 lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, folded);
+    for (int c = 0; c < 4; ++c) acc[c] += lanes[c];
+    if (i < n) SumSpanScalar(px + i, n - i, acc);
+}
+#endif
+
+sum_span_fn PickSumSpan()
+{
+#ifdef DOWNSCALER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SumSpanAvx2;
+    if (__builtin_cpu_supports("sse2")) return SumSpanSse2;
+#endif
+    return SumSpanScalar;
+}
+
+enum source_kind
+{
+    // Format_RGB32: the x byte is junk and alpha is always 255
+    SOURCE_OPAQUE,
+    // Format_ARGB32_Premultiplied: can be summed as it is
+    SOURCE_PREMULTIPLIED,
+    // Format_ARGB32: has to be premultiplied before it's summed
+    SOURCE_STRAIGHT
+};
+
+struct scale_job
+{
+    const uchar *src;
+    int src_stride;
+    uchar *dst;
+    int dst_stride;
+    int dst_width;
+    // dst_width + 1 and dst_height + 1 block edges in the source
+    const int *x_edges;
+    const int *y_edges;
+    source_kind kind;
+    sum_span_fn sum_span;
+};
+
+// adds one source row into the sums for each output column, a[dx * 4 + c]
+void AccumulateRow(const quint32 *line, const int *x_edges, int dst_width, source_kind kind, sum_span_fn sum_span, quint64 *a)
+{
+    for (int dx = 0; dx < dst_width; ++dx)
+    {
+        const int x0 = x_edges[dx];
+        const int x1 = x_edges[dx + 1];
+        quint64 *pa = a + dx * 4;
+        if (kind == SOURCE_STRAIGHT)
+        {
+            // premultiply on the way in; sums are 255 times too big until the end
+            for (int sx = x0; sx < x1; ++sx)
+            {
+                QRgb p = line[sx];
+                quint32 alpha = qAlpha(p);
+                pa[0] += qBlue(p) * alpha;
+                pa[1] += qGreen(p) * alpha;
+                pa[2] += qRed(p) * alpha;
+                pa[3] += alpha * 255;
+            }
+        }
+        else
+        {
+            quint32 row[4] = { 0, 0, 0, 0 };
+            sum_span(line + x0, x1 - x0, row);
+            for (int c = 0; c < 4; ++c) pa[c] += row[c];
+        }
+    }
+}
+
+// turns the sums of rows source rows into an output row
+void EmitRow(const quint64 *a, const int *x_edges, int dst_width, int rows, source_kind kind, QRgb *out)
+{
+    for (int dx = 0; dx < dst_width; ++dx)
+    {
+        const quint64 *pa = a + dx * 4;
+        quint64 count = (quint64)(x_edges[dx + 1] - x_edges[dx]) * rows;
+        if (kind == SOURCE_STRAIGHT) count *= 255;
+        const quint64 half = count / 2;
+        int b = (int)((pa[0] + half) / count);
+        int g = (int)((pa[1] + half) / count);
+        int r = (int)((pa[2] + half) / count);
+        int alpha = (kind == SOURCE_OPAQUE) ? 255 : (int)((pa[3] + half) / count);
+        out[dx] = qRgba(r, g, b, alpha);
+    }
+}
+
+void ScaleRows(const scale_job &job, int first_row, int last_row)
+{
+    QVector<quint64> acc(job.dst_width * 4);
+    for (int dy = first_row; dy < last_row; ++dy)
+    {
+        acc.fill(0);
+        const int y0 = job.y_edges[dy];
+        const int y1 = job.y_edges[dy + 1];
+        for (int sy = y0; sy < y1; ++sy)
+        {
+            const quint32 *line = (const quint32 *)(job.src + (qint64)sy * job.src_stride);
+            AccumulateRow(line, job.x_edges, job.dst_width, job.kind, job.sum_span, acc.data());
+        }
+        EmitRow(acc.constData(), job.x_edges, job.dst_width, y1 - y0, job.kind, (QRgb *)(job.dst + (qint64)dy * job.dst_stride));
+    }
+}
+
+class ScaleStrip : public QRunnable
+{
+public:
+    ScaleStrip(const scale_job &j, int first, int last, QSemaphore *d, bool i) :
+        job(j), first_row(first), last_row(last), done(d), idle(i) { }
+    void run() override
+    {
+        // threads of the idle pool never go back up, so this only does
+        // anything the first time round
+        if (idle && QThread::currentThread()->priority() != QThread::IdlePriority)
+            QThread::currentThread()->setPriority(QThread::IdlePriority);
+        ScaleRows(job, first_row, last_row);
+        done->release();
+    }
+private:
+    scale_job job;
+    int first_row, last_row;
+    QSemaphore *done;
+    bool idle;
+};
+
+// block edges: output pixel i covers source [edges[i], edges[i + 1])
+QVector<int> BlockEdges(int src_len, int dst_len)
+{
+    QVector<int> edges(dst_len + 1);
+    for (int i = 0; i <= dst_len; ++i) edges[i] = (int)((qint64)i * src_len / dst_len);
+    return edges;
+}
+
+sum_span_fn SumSpan()
+{
+    static const sum_span_fn sum_span = PickSumSpan();
+    return sum_span;
+}
+
+QThreadPool *NewStripPool()
+{
+    QThreadPool *pool = new QThreadPool;
+    pool->setMaxThreadCount(QThread::idealThreadCount());
+    return pool;
+}
+
+QThreadPool *StripPool(bool idle)
+{
+    // our own pools so a caller that's itself on the global pool can't end up
+    // waiting on strips that are queued behind it.  callers come from more
+    // than one thread, so they're made by static initializers.  idle priority
+    // callers get a pool of their own, or their strips would be scaled at
+    // normal priority and take cpu the desktop wants.
+    static QThreadPool *pools[2] = { NewStripPool(), NewStripPool() };
+    return pools[idle ? 1 : 0];
+}
+
+}
+
+QImage Downscaler::Scale(const QImage &src, int max_size)
+{
+    if (src.isNull() || max_size < 1) return QImage();
+    return Scale(src, src.size().scaled(max_size, max_size, Qt::KeepAspectRatio));
+}
+
+QImage Downscaler::Scale(const QImage &src, const QSize &size)
+{
+    if (src.isNull() || size.isEmpty()) return QImage();
+    if (size.width() > src.width() || size.height() > src.height())
+    {
+        return src.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+    QImage source = src;
+    source_kind kind;
+    switch (source.format())
+    {
+    case QImage::Format_RGB32: kind = SOURCE_OPAQUE; break;
+    case QImage::Format_ARGB32_Premultiplied: kind = SOURCE_PREMULTIPLIED; break;
+    case QImage::Format_ARGB32: kind = SOURCE_STRAIGHT; break;
+    default:
+        source = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        kind = SOURCE_PREMULTIPLIED;
+        break;
+    }
+    QImage dst(size, QImage::Format_ARGB32_Premultiplied);
+    if (dst.isNull()) return dst;
+    QVector<int> x_edges = BlockEdges(source.width(), size.width());
+    QVector<int> y_edges = BlockEdges(source.height(), size.height());
+    scale_job job;
+    job.src = source.constBits();
+    job.src_stride = source.bytesPerLine();
+    job.dst = dst.bits();
+    job.dst_stride = dst.bytesPerLine();
+    job.dst_width = size.width();
+    job.x_edges = x_edges.constData();
+    job.y_edges = y_edges.constData();
+    job.kind = kind;
+    job.sum_span = SumSpan();
+    int strips = 1;
+    if ((qint64)source.width() * source.height() >= DOWNSCALER_STRIP_THRESHOLD)
+        strips = qMin(QThread::idealThreadCount(), size.height());
+    if (strips <= 1)
+    {
+        ScaleRows(job, 0, size.height());
+        return dst;
+    }
+    // hand out all but the first strip and do that one here while we wait
+    QSemaphore done;
+    int rows = size.height();
+    bool idle = (QThread::currentThread()->priority() == QThread::IdlePriority);
+    for (int i = 1; i < strips; ++i)
+    {
+        StripPool(idle)->start(new ScaleStrip(job, rows * i / strips, rows * (i + 1) / strips, &done, idle));
+    }
+    ScaleRows(job, 0, rows / strips);
+    done.acquire(strips - 1);
+    return dst;
+}
+
+Downscaler::Stream::Stream(const QSize &src_size, const QSize &size) :
+    src_height(src_size.height()), src_row(0), dst_row(0), opaque(true)
+{
+    // only ever shrinks; the block edges need at least a pixel per block
+    if (src_size.isEmpty() || size.isEmpty() || size.width() > src_size.width() || size.height() > src_size.height()) return;
+    dst = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    if (dst.isNull()) return;
+    x_edges = BlockEdges(src_size.width(), size.width());
+    y_edges = BlockEdges(src_size.height(), size.height());
+    acc = QVector<quint64>(size.width() * 4, 0);
+}
+
+bool Downscaler::Stream::Feed(const QImage &rows, int first_row)
+{
+    if (dst.isNull() || rows.width() != x_edges.last() || first_row != src_row || src_row + rows.height() > src_height) return false;
+    // a block can straddle two strips, so whatever the first one was they
+    // all get summed as
+    if (!src_row) opaque = (rows.format() == QImage::Format_RGB32);
+    QImage source = rows;
+    QImage::Format format = opaque ? QImage::Format_RGB32 : QImage::Format_ARGB32_Premultiplied;
+    if (source.format() != format) source = source.convertToFormat(format);
+    const source_kind kind = opaque ? SOURCE_OPAQUE : SOURCE_PREMULTIPLIED;
+    const int dst_width = dst.width();
+    for (int y = 0; y < source.height(); ++y)
+    {
+        AccumulateRow((const quint32 *)source.constScanLine(y), x_edges.constData(), dst_width, kind, SumSpan(), acc.data());
+        if (++src_row < y_edges.at(dst_row + 1)) continue;
+        EmitRow(acc.constData(), x_edges.constData(), dst_width, y_edges.at(dst_row + 1) - y_edges.at(dst_row), kind, (QRgb *)dst.scanLine(dst_row));
+        acc.fill(0);
+        ++dst_row;
+    }
+    return true;
+}
+
+QImage Downscaler::Stream::Result() const
+{
+    return (!dst.isNull() && dst_row == dst.height()) ? dst : QImage();
+}
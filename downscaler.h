@@ -0,0 +1,63 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef DOWNSCALER_H
+#define DOWNSCALER_H
+
+#include <QImage>
+#include <QVector>
+
+// Area averaging downscaler for thumbnails.  Every destination pixel is the
+// average of the block of source pixels it covers, worked out in premultiplied
+// ARGB, so a 4K window going down to an icon looks like what Qt's smooth
+// scaling gives but without its cost.  The row sums use SSE2 or AVX2 when the
+// cpu has them, and big sources get split into strips of output rows that
+// run on their own thread pool.
+class Downscaler
+{
+public:
+    // scale src to fit in max_size x max_size, keeping the aspect ratio.
+    // always returns Format_ARGB32_Premultiplied.  anything that isn't a
+    // downscale goes to QImage::scaled instead.
+    static QImage Scale(const QImage &src, int max_size);
+    static QImage Scale(const QImage &src, const QSize &size);
+
+    // the same averaging for a source that turns up a few rows at a time,
+    // top to bottom, so all of it never has to be in memory at once.  only
+    // shrinks, and doesn't use the strip threads.
+    class Stream
+    {
+    public:
+        Stream(const QSize &src_size, const QSize &size);
+        // rows has to be the full width and start right where the last one
+        // ended; false if it doesn't
+        bool Feed(const QImage &rows, int first_row);
+        // null until every source row has been fed
+        QImage Result() const;
+
+    private:
+        QImage dst;
+        QVector<int> x_edges, y_edges;
+        // sums for the output row being worked on
+        QVector<quint64> acc;
+        int src_height, src_row, dst_row;
+        bool opaque;
+    };
+};
+
+#endif // DOWNSCALER_H
@@ -0,0 +1,62 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "ewmhatoms.h"
+#include "atomcache.h"
+#include <QStringList>
+
+// must stay in the same order as EwmhAtoms::Id
+static constexpr const char *atom_names[] = {
+    "_NET_CLIENT_LIST",
+    "_NET_ACTIVE_WINDOW",
+    "_NET_FRAME_WINDOW",
+    "_NET_WM_USER_TIME",
+    "_NET_WM_NAME",
+    "WM_NAME",
+    "WM_CLASS",
+    "_NET_WM_PID",
+    "UTF8_STRING",
+    "_NET_WM_ICON",
+    "_NET_WM_STATE",
+    "_NET_WM_STATE_HIDDEN",
+    "_NET_WM_STATE_SHADED",
+    "_NET_WM_STATE_BELOW",
+    "_NET_WM_STATE_STICKY",
+    "_NET_WM_STATE_SKIP_TASKBAR",
+    "_NET_WM_WINDOW_TYPE",
+    "_NET_WM_WINDOW_TYPE_DESKTOP",
+    "_NET_WM_WINDOW_TYPE_DOCK",
+    "_NET_WM_WINDOW_TYPE_TOOLBAR",
+    "_NET_WM_WINDOW_TYPE_MENU",
+    "_NET_WM_WINDOW_TYPE_UTILITY",
+    "_NET_WM_WINDOW_TYPE_SPLASH",
+    "_NET_WM_WINDOW_TYPE_DIALOG"
+};
+static_assert(sizeof(atom_names) / sizeof(atom_names[0]) == EwmhAtoms::ATOM_COUNT,
+              "atom_names is out of sync with EwmhAtoms::Id");
+
+xcb_atom_t EwmhAtoms::atoms[EwmhAtoms::ATOM_COUNT] = { XCB_ATOM_NONE };
+
+void EwmhAtoms::Resolve()
+{
+    QStringList names;
+    for (int i = 0; i < ATOM_COUNT; ++i) names.append(QString::fromLatin1(atom_names[i]));
+    AtomCache::Preload(names);
+    // these are all cached now, so no more round trips
+    for (int i = 0; i < ATOM_COUNT; ++i) atoms[i] = AtomCache::GetAtom(names.at(i));
+}
@@ -0,0 +1,66 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef EWMHATOMS_H
+#define EWMHATOMS_H
+
+#include <xcb/xcb.h>
+
+// Every atom the application knows about ahead of time.  They are all
+// interned together by Resolve() before the event filter is installed and
+// never written again afterward, so Get() is a plain array load that is safe
+// from any thread.  Use AtomCache for anything that is only known at runtime.
+class EwmhAtoms
+{
+public:
+    enum Id {
+        NET_CLIENT_LIST,
+        NET_ACTIVE_WINDOW,
+        NET_FRAME_WINDOW,
+        NET_WM_USER_TIME,
+        NET_WM_NAME,
+        WM_NAME,
+        WM_CLASS,
+        NET_WM_PID,
+        UTF8_STRING,
+        NET_WM_ICON,
+        NET_WM_STATE,
+        NET_WM_STATE_HIDDEN,
+        NET_WM_STATE_SHADED,
+        NET_WM_STATE_BELOW,
+        NET_WM_STATE_STICKY,
+        NET_WM_STATE_SKIP_TASKBAR,
+        NET_WM_WINDOW_TYPE,
+        NET_WM_WINDOW_TYPE_DESKTOP,
+        NET_WM_WINDOW_TYPE_DOCK,
+        NET_WM_WINDOW_TYPE_TOOLBAR,
+        NET_WM_WINDOW_TYPE_MENU,
+        NET_WM_WINDOW_TYPE_UTILITY,
+        NET_WM_WINDOW_TYPE_SPLASH,
+        NET_WM_WINDOW_TYPE_DIALOG,
+        ATOM_COUNT
+    };
+    static void Resolve();
+    static xcb_atom_t Get(Id id) { return atoms[id]; }
+
+private:
+    EwmhAtoms() {}
+    static xcb_atom_t atoms[ATOM_COUNT];
+};
+
+#endif // EWMHATOMS_H
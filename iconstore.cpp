@@ -0,0 +1,81 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "iconstore.h"
+#include "netwmicon.h"
+#include "ewmhatoms.h"
+#include "downscaler.h"
+#include "xcbeventfilter.h"
+#include <QCryptographicHash>
+#include <QMutexLocker>
+
+QMutex IconStore::lock;
+QHash<QByteArray, QWeakPointer<const QVector<QImage> > > IconStore::entries;
+QHash<int, QImage> IconStore::defaults;
+
+IconStore::Icons IconStore::Get(xcb_connection_t *c, xcb_window_t win)
+{
+    // send for the class first so it comes back while the icon is being fetched
+    xcb_get_property_cookie_t class_cookie = xcb_get_property(c, 0, win, EwmhAtoms::Get(EwmhAtoms::WM_CLASS), XCB_ATOM_STRING, 0, 256);
+    QByteArray raw = NetWmIcon::FetchRaw(c, win);
+    xcb_generic_error_t *err = nullptr;
+    xcb_get_property_reply_t *class_reply = xcb_get_property_reply(c, class_cookie, &err);
+    xcbEventFilter::errorHandler("IconStore::Get: get_property WM_CLASS: ", &err);
+    // instance and class, both nul terminated, make up the key's first part.
+    // if a window has no class its icon can still be shared by content alone.
+    QByteArray key;
+    if (class_reply)
+    {
+        if (class_reply->format == 8) key = QByteArray((const char *)xcb_get_property_value(class_reply), xcb_get_property_value_length(class_reply));
+        free(class_reply);
+    }
+    if (raw.isEmpty()) return Icons();
+    key.append('\0');
+    key.append(QCryptographicHash::hash(raw, QCryptographicHash::Sha1));
+    QMutexLocker locker(&lock);
+    Icons ret = entries.value(key).toStrongRef();
+    if (ret) return ret;
+    QVector<QImage> parsed = NetWmIcon::Parse(raw);
+    if (parsed.isEmpty()) return Icons();
+    ret = Icons(new QVector<QImage>(parsed));
+    // a good time to forget anything nobody is holding anymore
+    for (QHash<QByteArray, QWeakPointer<const QVector<QImage> > >::iterator it = entries.begin(); it != entries.end(); )
+    {
+        if (it.value().isNull()) it = entries.erase(it);
+        else ++it;
+    }
+    entries.insert(key, ret);
+    return ret;
+}
+
+QImage IconStore::Default(int size)
+{
+    QMutexLocker locker(&lock);
+    QHash<int, QImage>::const_iterator it = defaults.constFind(size);
+    if (it != defaults.constEnd()) return it.value();
+    // every size is made from the one decode we keep under 0
+    QImage original = defaults.value(0);
+    if (original.isNull())
+    {
+        original = QImage(":/resource/images/Default.png").convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        defaults.insert(0, original);
+    }
+    QImage ret = size > 0 ? Downscaler::Scale(original, size) : original;
+    defaults.insert(size, ret);
+    return ret;
+}
@@ -0,0 +1,52 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef ICONSTORE_H
+#define ICONSTORE_H
+
+#include <QImage>
+#include <QVector>
+#include <QHash>
+#include <QByteArray>
+#include <QSharedPointer>
+#include <QMutex>
+#include <xcb/xcb.h>
+
+// Window icons shared across the whole process.  Windows of one application
+// nearly always carry the same _NET_WM_ICON, so icons are looked up by
+// WM_CLASS plus a hash of the property and only parsed the first time; every
+// window after that gets a reference to the same images.  An entry goes away
+// with the last window holding it.  The default icon is decoded once and
+// kept scaled to each size it's been asked for.
+class IconStore
+{
+public:
+    typedef QSharedPointer<const QVector<QImage> > Icons;
+    // null if the window has no usable icon
+    static Icons Get(xcb_connection_t *c, xcb_window_t win);
+    // Default.png scaled to fit size x size, or as it is for size 0
+    static QImage Default(int size);
+
+private:
+    IconStore() {}
+    static QMutex lock;
+    static QHash<QByteArray, QWeakPointer<const QVector<QImage> > > entries;
+    static QHash<int, QImage> defaults;
+};
+
+#endif // ICONSTORE_H
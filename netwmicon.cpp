@@ -0,0 +1,163 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "netwmicon.h"
+#include "ewmhatoms.h"
+#include "xcbeventfilter.h"
+#include <QDebug>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NETWMICON_X86 1
+#include <immintrin.h>
+#endif
+
+// nobody needs more icon than this, in 32 bit words (16 MB)
+#define NETWMICON_MAX_WORDS (4UL * 1024 * 1024)
+
+namespace
+{
+
+typedef void (*premultiply_fn)(const quint32 *src, quint32 *dst, int n);
+
+inline quint32 MulDiv255(quint32 x, quint32 a)
+{
+    // x * a / 255, rounded
+    quint32 t = x * a + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+void PremultiplyScalar(const quint32 *src, quint32 *dst, int n)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        quint32 p = src[i], a = p >> 24;
+        dst[i] = (p & 0xff000000) | (MulDiv255((p >> 16) & 0xff, a) << 16) | (MulDiv255((p >> 8) & 0xff, a) << 8) | MulDiv255(p & 0xff, a);
+    }
+}
+
+#ifdef NETWMICON_X86
+__attribute__((target("sse2")))
+void PremultiplySse2(const quint32 *src, quint32 *dst, int n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi16(128);
+    const __m128i alpha_mask = _mm_set1_epi32((int)0xff000000);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i p = _mm_loadu_si128((const __m128i *)(src + i));
+        // two pixels per half, each channel times its pixel's alpha, then
+        // divided by 255 with rounding: (x + 128 + ((x + 128) >> 8)) >> 8
+        __m128i lo = _mm_unpacklo_epi8(p, zero);
+        __m128i hi = _mm_unpackhi_epi8(p, zero);
+        lo = _mm_mullo_epi16(lo, _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xff), 0xff));
+        hi = _mm_mullo_epi16(hi, _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xff), 0xff));
+        lo = _mm_add_epi16(lo, round);
+        hi = _mm_add_epi16(hi, round);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+        // alpha went through the same sum as the colors, so put it back as it was
+        __m128i out = _mm_packus_epi16(lo, hi);
+        out = _mm_or_si128(_mm_andnot_si128(alpha_mask, out), _mm_and_si128(alpha_mask, p));
+        _mm_storeu_si128((__m128i *)(dst + i), out);
+    }
+    if (i < n) PremultiplyScalar(src + i, dst + i, n - i);
+}
+#endif
+
+premultiply_fn PickPremultiply()
+{
+#ifdef NETWMICON_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) return PremultiplySse2;
+#endif
+    return PremultiplyScalar;
+}
+
+}
+
+QByteArray NetWmIcon::FetchRaw(xcb_connection_t *c, xcb_window_t win)
+{
+    const xcb_atom_t net_wm_icon = EwmhAtoms::Get(EwmhAtoms::NET_WM_ICON);
+    QByteArray ret;
+    // ask for nothing, which still tells us how much there is
+    xcb_generic_error_t *err = nullptr;
+    xcb_get_property_cookie_t probe_cookie = xcb_get_property(c, 0, win, net_wm_icon, XCB_ATOM_CARDINAL, 0, 0);
+    xcb_get_property_reply_t *probe_reply = xcb_get_property_reply(c, probe_cookie, &err);
+    xcbEventFilter::errorHandler("NetWmIcon::FetchRaw: get_property _NET_WM_ICON length: ", &err);
+    if (!probe_reply) return ret;
+    uint8_t data_fmt = probe_reply->format;
+    uint32_t words = probe_reply->bytes_after / 4;
+    free(probe_reply);
+    if (!data_fmt) return ret;
+    if (data_fmt != 32)
+    {
+        qDebug() << "NetWmIcon::FetchRaw: window icon has unrecognized format " << data_fmt;
+        return ret;
+    }
+    if (words < 3) return ret;
+    if (words > NETWMICON_MAX_WORDS) words = NETWMICON_MAX_WORDS;
+    xcb_get_property_cookie_t prop_cookie = xcb_get_property(c, 0, win, net_wm_icon, XCB_ATOM_CARDINAL, 0, words);
+    xcb_get_property_reply_t *prop_reply = xcb_get_property_reply(c, prop_cookie, &err);
+    xcbEventFilter::errorHandler("NetWmIcon::FetchRaw: get_property _NET_WM_ICON: ", &err);
+    if (!prop_reply) return ret;
+    if (prop_reply->format == 32)
+    {
+        ret = QByteArray((const char *)xcb_get_property_value(prop_reply), xcb_get_property_value_length(prop_reply) & ~3);
+    }
+    free(prop_reply);
+    return ret;
+}
+
+QVector<QImage> NetWmIcon::Parse(const QByteArray &raw)
+{
+    static const premultiply_fn premultiply = PickPremultiply();
+    QVector<QImage> ret;
+    const quint32 *data = (const quint32 *)raw.constData();
+    quint64 len = raw.size() / 4;
+    quint64 pos = 0;
+    while (pos + 2 <= len)
+    {
+        quint64 icon_width = data[pos], icon_height = data[pos + 1];
+        quint64 pixels = icon_width * icon_height;
+        // a bad entry means we can't tell where the next one starts either
+        if (!pixels || icon_width > 0x7fff || icon_height > 0x7fff || pos + 2 + pixels > len) break;
+        QImage icon(icon_width, icon_height, QImage::Format_ARGB32_Premultiplied);
+        if (icon.isNull()) break;
+        for (int y = 0; y < (int)icon_height; ++y)
+        {
+            premultiply(data + pos + 2 + (quint64)y * icon_width, reinterpret_cast<quint32 *>(icon.scanLine(y)), icon_width);
+        }
+        ret.append(icon);
+        pos += 2 + pixels;
+    }
+    return ret;
+}
+
+QImage NetWmIcon::Pick(const QVector<QImage> &icons, int size)
+{
+    int best = -1, biggest = -1;
+    for (int i = 0; i < icons.count(); ++i)
+    {
+        int extent = qMax(icons.at(i).width(), icons.at(i).height());
+        if (biggest < 0 || extent > qMax(icons.at(biggest).width(), icons.at(biggest).height())) biggest = i;
+        if (size > 0 && extent >= size && (best < 0 || extent < qMax(icons.at(best).width(), icons.at(best).height()))) best = i;
+    }
+    if (best < 0) best = biggest;
+    return best < 0 ? QImage() : icons.at(best);
+}
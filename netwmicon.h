@@ -0,0 +1,44 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef NETWMICON_H
+#define NETWMICON_H
+
+#include <QImage>
+#include <QVector>
+#include <QByteArray>
+#include <xcb/xcb.h>
+
+// Reads a window's _NET_WM_ICON.  The property is a list of icons (width,
+// height, then width * height straight ARGB pixels each), so its length is
+// asked for first and then exactly that much is fetched.  Parse() splits it
+// up and premultiplies each icon (with SSE2 where there is some) into an
+// image of its own, and Pick() chooses which one to show.
+class NetWmIcon
+{
+public:
+    // the property's words as they came, empty if there isn't one
+    static QByteArray FetchRaw(xcb_connection_t *c, xcb_window_t win);
+    // empty if there's no usable icon in there
+    static QVector<QImage> Parse(const QByteArray &raw);
+    // the smallest icon at least size big, or failing that the biggest one.
+    // size 0 just gets the biggest.
+    static QImage Pick(const QVector<QImage> &icons, int size);
+};
+
+#endif // NETWMICON_H
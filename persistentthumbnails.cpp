@@ -0,0 +1,239 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "persistentthumbnails.h"
+#include "ewmhatoms.h"
+#include "xcbeventfilter.h"
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QSaveFile>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThread>
+#include <QDebug>
+#include <cstring>
+
+// anything past this many windows is most likely from a session long gone
+#define PERSIST_MAX_FILES 512
+// nobody has an icon bigger than this
+#define PERSIST_MAX_SIDE 1024
+
+namespace
+{
+    // bump the last byte of the magic whenever this changes
+    struct file_header
+    {
+        char magic[8];
+        // written in our own byte order, so a file from another one is junk
+        quint32 byte_order;
+        quint32 window;
+        quint32 width, height, stride;
+        char identity[20];
+        char reserved[16];
+    };
+    static_assert(sizeof(file_header) == 64, "file_header should keep the pixels 64 byte aligned");
+
+    const char file_magic[8] = { 'W', 'M', 'I', 'I', 'B', 'T', 'H', 1 };
+    const quint32 file_byte_order = 0x01020304;
+
+    // keeps the file open (and so mapped) for as long as the image uses it
+    struct mapping
+    {
+        QFile file;
+        uchar *addr;
+    };
+
+    void Unmap(void *info)
+    {
+        mapping *m = (mapping *)info;
+        m->file.unmap(m->addr);
+        delete m;
+    }
+    class Job : public QRunnable
+    {
+    public:
+        explicit Job(const std::function<void()> &f) : fn(f) { }
+        void run() override
+        {
+            // nobody is waiting on these
+            if (QThread::currentThread()->priority() != QThread::LowPriority) QThread::currentThread()->setPriority(QThread::LowPriority);
+            fn();
+        }
+    private:
+        std::function<void()> fn;
+    };
+}
+
+PersistentThumbnails::PersistentThumbnails(QObject *parent) :
+    QObject(parent)
+{
+    QString base = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (base.isEmpty()) return;
+    QDir thumbs_dir(base + "/thumbnails");
+    if (!thumbs_dir.mkpath(".")) qDebug() << "PersistentThumbnails: couldn't create" << thumbs_dir.absolutePath();
+    else dir = thumbs_dir.absolutePath();
+    // one thread, so writes to the same file can't overtake each other
+    writer.setMaxThreadCount(1);
+    if (IsAvailable()) Queue([this]() { Prune(); });
+}
+
+PersistentThumbnails::~PersistentThumbnails()
+{
+    Flush();
+}
+
+PersistentThumbnails::IdentityRequest PersistentThumbnails::RequestIdentity(xcb_connection_t *c, xcb_window_t win)
+{
+    IdentityRequest ret;
+    ret.wm_class = xcb_get_property(c, 0, win, EwmhAtoms::Get(EwmhAtoms::WM_CLASS), XCB_ATOM_STRING, 0, 256);
+    ret.pid = xcb_get_property(c, 0, win, EwmhAtoms::Get(EwmhAtoms::NET_WM_PID), XCB_ATOM_CARDINAL, 0, 1);
+    return ret;
+}
+
+QByteArray PersistentThumbnails::Identify(xcb_connection_t *c, const IdentityRequest &request)
+{
+    xcb_generic_error_t *err = nullptr;
+    QByteArray wm_class;
+    xcb_get_property_reply_t *class_reply = xcb_get_property_reply(c, request.wm_class, &err);
+    xcbEventFilter::errorHandler("PersistentThumbnails::Identify: get_property WM_CLASS: ", &err);
+    if (class_reply)
+    {
+        if (class_reply->format == 8) wm_class = QByteArray((const char *)xcb_get_property_value(class_reply), xcb_get_property_value_length(class_reply));
+        free(class_reply);
+    }
+    quint32 pid = 0;
+    xcb_get_property_reply_t *pid_reply = xcb_get_property_reply(c, request.pid, &err);
+    xcbEventFilter::errorHandler("PersistentThumbnails::Identify: get_property _NET_WM_PID: ", &err);
+    if (pid_reply)
+    {
+        if (pid_reply->format == 32 && xcb_get_property_value_length(pid_reply) >= 4) pid = *(const quint32 *)xcb_get_property_value(pid_reply);
+        free(pid_reply);
+    }
+    if (wm_class.isEmpty() && !pid) return QByteArray();
+    // the window id is in the file name and X hands ids out in order, so
+    // together with the owner's pid that's as good as knowing when it was
+    // created.  the display keeps two X servers from sharing files.
+    QByteArray id = qgetenv("DISPLAY");
+    id.append('\0');
+    id.append(wm_class);
+    id.append('\0');
+    id.append(QByteArray::number(pid));
+    return QCryptographicHash::hash(id, QCryptographicHash::Sha1);
+}
+
+QString PersistentThumbnails::Path(xcb_window_t win) const
+{
+    return dir + QString("/%1.thumb").arg(win, 8, 16, QChar('0'));
+}
+
+void PersistentThumbnails::Load(xcb_window_t win, const QByteArray &identity)
+{
+    if (!IsAvailable() || identity.size() != (int)sizeof(file_header::identity)) return;
+    // behind any write or remove of the same file that's still queued
+    Queue([this, win, identity]() {
+        QImage icon = Read(win, identity);
+        if (!icon.isNull()) emit Loaded(win, identity, icon);
+    });
+}
+
+QImage PersistentThumbnails::Read(xcb_window_t win, const QByteArray &identity) const
+{
+    mapping *m = new mapping;
+    m->file.setFileName(Path(win));
+    m->addr = nullptr;
+    if (!m->file.open(QIODevice::ReadOnly) || m->file.size() < (qint64)sizeof(file_header))
+    {
+        delete m;
+        return QImage();
+    }
+    m->addr = m->file.map(0, m->file.size());
+    const file_header *h = (const file_header *)m->addr;
+    bool ok = h && !memcmp(h->magic, file_magic, sizeof(file_magic)) && h->byte_order == file_byte_order && h->window == win &&
+              !memcmp(h->identity, identity.constData(), sizeof(h->identity)) &&
+              h->width > 0 && h->height > 0 && h->width <= PERSIST_MAX_SIDE && h->height <= PERSIST_MAX_SIDE &&
+              h->stride >= h->width * 4 && !(h->stride % 4) &&
+              m->file.size() >= (qint64)sizeof(file_header) + (qint64)h->stride * h->height;
+    if (!ok)
+    {
+        // some other window's, or from an older version
+        if (m->addr) m->file.unmap(m->addr);
+        m->file.close();
+        m->file.remove();
+        delete m;
+        return QImage();
+    }
+    // the pixels are used right where they are
+    return QImage(m->addr + sizeof(file_header), h->width, h->height, h->stride, QImage::Format_ARGB32_Premultiplied, Unmap, m);
+}
+
+void PersistentThumbnails::Store(xcb_window_t win, const QByteArray &identity, const QImage &icon)
+{
+    if (!IsAvailable() || identity.size() != (int)sizeof(file_header::identity) || icon.isNull()) return;
+    if (icon.width() > PERSIST_MAX_SIDE || icon.height() > PERSIST_MAX_SIDE) return;
+    // the image is shared, not copied, until something writes to it
+    Queue([this, win, identity, icon]() { Write(win, identity, icon); });
+}
+
+void PersistentThumbnails::Write(xcb_window_t win, const QByteArray &identity, const QImage &icon) const
+{
+    QImage img = icon.format() == QImage::Format_ARGB32_Premultiplied ? icon : icon.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    file_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, file_magic, sizeof(file_magic));
+    h.byte_order = file_byte_order;
+    h.window = win;
+    h.width = img.width();
+    h.height = img.height();
+    h.stride = img.width() * 4;
+    memcpy(h.identity, identity.constData(), sizeof(h.identity));
+    // written next to the old one and renamed over it, so a crash never
+    // leaves half a file to be mapped
+    QSaveFile out(Path(win));
+    if (!out.open(QIODevice::WriteOnly))
+    {
+        qDebug() << "PersistentThumbnails::Store: couldn't write" << Path(win);
+        return;
+    }
+    out.write((const char *)&h, sizeof(h));
+    for (int y = 0; y < img.height(); ++y) out.write((const char *)img.constScanLine(y), h.stride);
+    if (!out.commit()) qDebug() << "PersistentThumbnails::Store: couldn't write" << Path(win);
+}
+
+void PersistentThumbnails::Remove(xcb_window_t win)
+{
+    if (IsAvailable()) Queue([this, win]() { QFile::remove(Path(win)); });
+}
+
+void PersistentThumbnails::Flush()
+{
+    writer.waitForDone();
+}
+
+void PersistentThumbnails::Queue(const std::function<void()> &fn)
+{
+    writer.start(new Job(fn));
+}
+
+void PersistentThumbnails::Prune() const
+{
+    QFileInfoList files = QDir(dir).entryInfoList(QStringList() << "*.thumb", QDir::Files, QDir::Time);
+    // newest first
+    for (int i = PERSIST_MAX_FILES; i < files.count(); ++i) QFile::remove(files.at(i).absoluteFilePath());
+}
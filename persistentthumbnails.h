@@ -0,0 +1,82 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef PERSISTENTTHUMBNAILS_H
+#define PERSISTENTTHUMBNAILS_H
+
+#include <QObject>
+#include <QImage>
+#include <QString>
+#include <QByteArray>
+#include <QThreadPool>
+#include <functional>
+#include <xcb/xcb.h>
+
+// Icons kept on disk so a restart doesn't leave every window that's already
+// iconified showing the default one (there's no pixmap to capture from an
+// unmapped window).  One file per window under the cache directory: a small
+// header and then the raw premultiplied ARGB32 rows, so loading is mapping
+// the file and pointing a QImage at it.  Window ids get reused, so each file
+// also holds a hash of who the window belongs to, and a file that doesn't
+// match is thrown away.  Everything that touches the disk happens on a
+// thread of its own.
+class PersistentThumbnails : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PersistentThumbnails(QObject *parent = nullptr);
+    // waits for whatever is still being written
+    ~PersistentThumbnails();
+    // false if there's nowhere to write
+    bool IsAvailable() const { return !dir.isEmpty(); }
+    // what Identify() needs from the server, asked for up front so the
+    // replies can be picked up later without waiting on them
+    struct IdentityRequest
+    {
+        xcb_get_property_cookie_t wm_class, pid;
+    };
+    static IdentityRequest RequestIdentity(xcb_connection_t *c, xcb_window_t win);
+    // display, WM_CLASS and _NET_WM_PID, hashed; empty if the window has
+    // neither a class nor a pid to go by.  collects request's replies.
+    static QByteArray Identify(xcb_connection_t *c, const IdentityRequest &request);
+    // looks for the saved icon and hands it to Loaded() if there is one.
+    // loading, writing and removing happen one at a time on a thread of
+    // their own, in the order they were asked for.
+    void Load(xcb_window_t win, const QByteArray &identity);
+    void Store(xcb_window_t win, const QByteArray &identity, const QImage &icon);
+    void Remove(xcb_window_t win);
+    // blocks until everything asked for so far is done
+    void Flush();
+
+signals:
+    // from the disk thread; icon points into the mapped file
+    void Loaded(uint win, const QByteArray &identity, const QImage &icon);
+
+private:
+    QString Path(xcb_window_t win) const;
+    void Queue(const std::function<void()> &fn);
+    // the saved icon or a null image, and a file that doesn't match is removed
+    QImage Read(xcb_window_t win, const QByteArray &identity) const;
+    void Write(xcb_window_t win, const QByteArray &identity, const QImage &icon) const;
+    // drops the oldest files once there are too many
+    void Prune() const;
+    QString dir;
+    QThreadPool writer;
+};
+
+#endif // PERSISTENTTHUMBNAILS_H
@@ -0,0 +1,207 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "pixelconvert.h"
+
+namespace
+{
+    // one color channel: value = lut[(pixel >> shift) & mask].  channels
+    // wider than 8 bits drop their low bits in the shift, narrower ones get
+    // widened by the table so full intensity still comes out as 255.
+    struct channel
+    {
+        int shift;
+        uint32_t mask;
+        uchar lut[256];
+    };
+
+    void SetupChannel(channel &ch, uint32_t mask)
+    {
+        int shift = 0, bits = 0;
+        if (mask)
+        {
+            while (!(mask & (1U << shift))) ++shift;
+            while (shift + bits < 32 && (mask & (1U << (shift + bits)))) ++bits;
+        }
+        if (bits > 8)
+        {
+            shift += bits - 8;
+            bits = 8;
+        }
+        ch.shift = shift;
+        ch.mask = bits ? (1U << bits) - 1 : 0;
+        for (uint32_t v = 0; v < 256; ++v)
+        {
+            if (!bits)
+            {
+                ch.lut[v] = 0;
+                continue;
+            }
+            // repeat the bits we have into the ones we don't
+            uint32_t wide = (v & ch.mask) << (8 - bits);
+            for (int have = bits; have < 8; have *= 2) wide |= wide >> have;
+            ch.lut[v] = (uchar)wide;
+        }
+    }
+
+    template<int BYTES, bool MSB>
+    inline uint32_t Load(const uchar *p)
+    {
+        // the loop goes away, what's left is a load and maybe a byte swap
+        uint32_t v = 0;
+        for (int i = 0; i < BYTES; ++i)
+        {
+            if (MSB) v = (v << 8) | p[i];
+            else v |= (uint32_t)p[i] << (8 * i);
+        }
+        return v;
+    }
+
+    template<int BYTES, bool MSB, bool ALPHA>
+    void ConvertRows(const uchar *src, int src_stride, QImage &dst, const channel *ch)
+    {
+        int width = dst.width();
+        for (int y = 0; y < dst.height(); ++y)
+        {
+            const uchar *s = src + (size_t)y * src_stride;
+            QRgb *d = reinterpret_cast<QRgb *>(dst.scanLine(y));
+            for (int x = 0; x < width; ++x, s += BYTES)
+            {
+                uint32_t p = Load<BYTES, MSB>(s);
+                uint32_t r = ch[0].lut[(p >> ch[0].shift) & ch[0].mask];
+                uint32_t g = ch[1].lut[(p >> ch[1].shift) & ch[1].mask];
+                uint32_t b = ch[2].lut[(p >> ch[2].shift) & ch[2].mask];
+                uint32_t a = 0xff;
+                if (ALPHA)
+                {
+                    a = ch[3].lut[(p >> ch[3].shift) & ch[3].mask];
+                    // rounding the channels separately can push a color past
+                    // its alpha, which premultiplied pixels must never do
+                    r = qMin(r, a);
+                    g = qMin(g, a);
+                    b = qMin(b, a);
+                }
+                d[x] = (a << 24) | (r << 16) | (g << 8) | b;
+            }
+        }
+    }
+
+    template<int BYTES>
+    void Dispatch(const uchar *src, int src_stride, QImage &dst, const channel *ch, bool msb_first, bool alpha)
+    {
+        if (msb_first)
+        {
+            if (alpha) ConvertRows<BYTES, true, true>(src, src_stride, dst, ch);
+            else ConvertRows<BYTES, true, false>(src, src_stride, dst, ch);
+        }
+        else
+        {
+            if (alpha) ConvertRows<BYTES, false, true>(src, src_stride, dst, ch);
+            else ConvertRows<BYTES, false, false>(src, src_stride, dst, ch);
+        }
+    }
+}
+
+int PixelConvert::Layout::Stride(int width) const
+{
+    int pad = scanline_pad ? scanline_pad : 32;
+    return (int)((((qint64)width * bits_per_pixel + pad - 1) / pad) * pad / 8);
+}
+
+PixelConvert::Layout PixelConvert::Describe(xcb_connection_t *c, xcb_visualid_t visual, uint8_t depth)
+{
+    Layout ret;
+    const xcb_setup_t *setup = xcb_get_setup(c);
+    const xcb_visualtype_t *vt = nullptr;
+    for (xcb_screen_iterator_t si = xcb_setup_roots_iterator(setup); si.rem && !vt; xcb_screen_next(&si))
+    {
+        for (xcb_depth_iterator_t di = xcb_screen_allowed_depths_iterator(si.data); di.rem && !vt; xcb_depth_next(&di))
+        {
+            if (di.data->depth != depth) continue;
+            for (xcb_visualtype_iterator_t vi = xcb_depth_visuals_iterator(di.data); vi.rem; xcb_visualtype_next(&vi))
+            {
+                if (vi.data->visual_id == visual)
+                {
+                    vt = vi.data;
+                    break;
+                }
+            }
+        }
+    }
+    if (!vt || (vt->_class != XCB_VISUAL_CLASS_TRUE_COLOR && vt->_class != XCB_VISUAL_CLASS_DIRECT_COLOR)) return ret;
+    for (xcb_format_iterator_t fi = xcb_setup_pixmap_formats_iterator(setup); fi.rem; xcb_format_next(&fi))
+    {
+        if (fi.data->depth != depth) continue;
+        // only whole byte pixels from here on
+        if (fi.data->bits_per_pixel != 16 && fi.data->bits_per_pixel != 24 && fi.data->bits_per_pixel != 32) return ret;
+        ret.bits_per_pixel = fi.data->bits_per_pixel;
+        ret.scanline_pad = fi.data->scanline_pad;
+        break;
+    }
+    if (!ret.bits_per_pixel) return ret;
+    ret.depth = depth;
+    ret.msb_first = (setup->image_byte_order == XCB_IMAGE_ORDER_MSB_FIRST);
+    ret.red_mask = vt->red_mask;
+    ret.green_mask = vt->green_mask;
+    ret.blue_mask = vt->blue_mask;
+    uint32_t depth_mask = depth >= 32 ? 0xffffffffU : (1U << depth) - 1;
+    ret.alpha_mask = depth_mask & ~(vt->red_mask | vt->green_mask | vt->blue_mask);
+    return ret;
+}
+
+QImage PixelConvert::ToImage(const uchar *data, uint32_t len, int width, int height, const Layout &layout,
+                             QImageCleanupFunction cleanup, void *cleanup_info)
+{
+    QImage ret;
+    int stride = layout.IsValid() ? layout.Stride(width) : 0;
+    if (!(stride && data && width > 0 && height > 0 && (quint64)len >= (quint64)stride * height))
+    {
+        if (cleanup) cleanup(cleanup_info);
+        return ret;
+    }
+    bool alpha = (layout.alpha_mask != 0);
+    QImage::Format format = alpha ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32;
+    // plain 8 bit channels in our own byte order are already what QImage wants
+    bool native = (layout.bits_per_pixel == 32 && layout.msb_first == (Q_BYTE_ORDER == Q_BIG_ENDIAN) &&
+                   layout.red_mask == 0xff0000 && layout.green_mask == 0xff00 && layout.blue_mask == 0xff &&
+                   (!alpha || layout.alpha_mask == 0xff000000U));
+    if (native) return QImage(data, width, height, stride, format, cleanup, cleanup_info);
+    ret = QImage(width, height, format);
+    if (!ret.isNull())
+    {
+        channel ch[4];
+        SetupChannel(ch[0], layout.red_mask);
+        SetupChannel(ch[1], layout.green_mask);
+        SetupChannel(ch[2], layout.blue_mask);
+        SetupChannel(ch[3], layout.alpha_mask);
+        switch (layout.bits_per_pixel)
+        {
+        case 16:
+            Dispatch<2>(data, stride, ret, ch, layout.msb_first, alpha);
+            break;
+        case 24:
+            Dispatch<3>(data, stride, ret, ch, layout.msb_first, alpha);
+            break;
+        default:
+            Dispatch<4>(data, stride, ret, ch, layout.msb_first, alpha);
+            break;
+        }
+    }
+    if (cleanup) cleanup(cleanup_info);
+    return ret;
+}
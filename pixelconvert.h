@@ -0,0 +1,58 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef PIXELCONVERT_H
+#define PIXELCONVERT_H
+
+#include <QImage>
+#include <xcb/xcb.h>
+
+// Turns the Z pixmap data get_image (or shm get_image) hands back into a
+// QImage.  X sends pixels in the drawable's own layout: 16 bit 565, 10 bits
+// per channel, 32 bit ARGB, the server's byte order and so on, so it's worked
+// out from the visual and depth what that layout is and then converted with a
+// kernel built for it.  The common 24/32 bit layouts need no converting at
+// all and are only wrapped.
+class PixelConvert
+{
+public:
+    struct Layout
+    {
+        Layout() : depth(0), bits_per_pixel(0), scanline_pad(0), msb_first(false),
+            red_mask(0), green_mask(0), blue_mask(0), alpha_mask(0) { }
+        uint8_t depth, bits_per_pixel, scanline_pad;
+        // the server's image byte order
+        bool msb_first;
+        // alpha is whatever the depth has left over after the colors; like
+        // everything else in render it's premultiplied
+        uint32_t red_mask, green_mask, blue_mask, alpha_mask;
+        bool IsValid() const { return bits_per_pixel != 0; }
+        int Stride(int width) const;
+    };
+    // invalid unless visual is a TrueColor or DirectColor one we can convert
+    static Layout Describe(xcb_connection_t *c, xcb_visualid_t visual, uint8_t depth);
+    // Format_RGB32 for layouts without alpha, Format_ARGB32_Premultiplied for
+    // the rest, or a null image if len is too short.  like the QImage
+    // constructor, cleanup(cleanup_info) gets called once data isn't needed,
+    // which is right away if it had to be converted.  without a cleanup
+    // function a wrapped image still points at data.
+    static QImage ToImage(const uchar *data, uint32_t len, int width, int height, const Layout &layout,
+                          QImageCleanupFunction cleanup = nullptr, void *cleanup_info = nullptr);
+};
+
+#endif // PIXELCONVERT_H
@@ -0,0 +1,141 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "renderscaler.h"
+#include "xcbeventfilter.h"
+#include "pixelconvert.h"
+#include <QDebug>
+
+// the server's "good" filter is bilinear, which only looks at a few source
+// pixels per output pixel.  so scale to this many times the icon size on the
+// server and leave the last step to the area averaging on our side.
+#define RENDER_OVERSAMPLE 2
+
+RenderScaler::RenderScaler(xcb_connection_t *c) :
+    connection(c), available(false), argb32_format(0)
+{
+    xcb_generic_error_t *err = nullptr;
+    // transforms and filters both need 0.6
+    xcb_render_query_version_cookie_t qv_cookie = xcb_render_query_version(connection, 0, 11);
+    xcb_render_query_pict_formats_cookie_t pf_cookie = xcb_render_query_pict_formats(connection);
+    xcb_render_query_version_reply_t *qv_reply = xcb_render_query_version_reply(connection, qv_cookie, &err);
+    bool version_ok = false;
+    if (qv_reply)
+    {
+        version_ok = (qv_reply->major_version > 0 || qv_reply->minor_version >= 6);
+        free(qv_reply);
+    }
+    free(err);
+    err = nullptr;
+    xcb_render_query_pict_formats_reply_t *pf_reply = xcb_render_query_pict_formats_reply(connection, pf_cookie, &err);
+    free(err);
+    if (!pf_reply) return;
+    // the format we render into: plain 8 bit a, r, g, b
+    for (xcb_render_pictforminfo_iterator_t fi = xcb_render_query_pict_formats_formats_iterator(pf_reply); fi.rem; xcb_render_pictforminfo_next(&fi))
+    {
+        const xcb_render_pictforminfo_t *info = fi.data;
+        if (info->type == XCB_RENDER_PICT_TYPE_DIRECT && info->depth == 32 &&
+            info->direct.alpha_mask == 0xff && info->direct.alpha_shift == 24 &&
+            info->direct.red_mask == 0xff && info->direct.red_shift == 16 &&
+            info->direct.green_mask == 0xff && info->direct.green_shift == 8 &&
+            info->direct.blue_mask == 0xff && info->direct.blue_shift == 0)
+        {
+            argb32_format = info->id;
+            break;
+        }
+    }
+    // and what each visual's windows look like as a source
+    for (xcb_render_pictscreen_iterator_t si = xcb_render_query_pict_formats_screens_iterator(pf_reply); si.rem; xcb_render_pictscreen_next(&si))
+    {
+        for (xcb_render_pictdepth_iterator_t di = xcb_render_pictscreen_depths_iterator(si.data); di.rem; xcb_render_pictdepth_next(&di))
+        {
+            for (xcb_render_pictvisual_iterator_t vi = xcb_render_pictdepth_visuals_iterator(di.data); vi.rem; xcb_render_pictvisual_next(&vi))
+            {
+                visual_formats.insert(vi.data->visual, vi.data->format);
+            }
+        }
+    }
+    free(pf_reply);
+    available = version_ok && argb32_format;
+}
+
+QImage RenderScaler::Scale(xcb_drawable_t src, xcb_visualid_t visual, uint16_t src_width, uint16_t src_height, const QSize &size)
+{
+    QImage ret;
+    xcb_render_pictformat_t src_format = visual_formats.value(visual, 0);
+    if (!(available && src_format && src_width && src_height) || size.isEmpty()) return ret;
+    int dst_width = qMin((int)src_width, size.width() * RENDER_OVERSAMPLE);
+    int dst_height = qMin((int)src_height, size.height() * RENDER_OVERSAMPLE);
+    // the source is where a bad drawable or format shows up, so it and
+    // everything using it are checked once the image is in, which no longer waits
+    xcb_render_picture_t src_pict = xcb_generate_id(connection);
+    xcb_void_cookie_t src_cookie = xcb_render_create_picture_checked(connection, src_pict, src, src_format, 0, nullptr);
+    xcb_pixmap_t dst_pm = xcb_generate_id(connection);
+    xcb_create_pixmap(connection, 32, dst_pm, src, dst_width, dst_height);
+    xcb_render_picture_t dst_pict = xcb_generate_id(connection);
+    xcb_render_create_picture(connection, dst_pict, dst_pm, argb32_format, 0, nullptr);
+    // the transform maps destination coordinates back into the source
+    xcb_render_transform_t transform = {
+        (xcb_render_fixed_t)(((qint64)src_width << 16) / dst_width), 0, 0,
+        0, (xcb_render_fixed_t)(((qint64)src_height << 16) / dst_height), 0,
+        0, 0, 1 << 16
+    };
+    xcb_void_cookie_t uses[3];
+    uses[0] = xcb_render_set_picture_transform_checked(connection, src_pict, transform);
+    static const char filter[] = "good";
+    uses[1] = xcb_render_set_picture_filter_checked(connection, src_pict, sizeof(filter) - 1, filter, 0, nullptr);
+    uses[2] = xcb_render_composite_checked(connection, XCB_RENDER_PICT_OP_SRC, src_pict, XCB_NONE, dst_pict, 0, 0, 0, 0, 0, 0, dst_width, dst_height);
+    xcb_generic_error_t *err = nullptr;
+    xcb_get_image_cookie_t gi_cookie = xcb_get_image(connection, XCB_IMAGE_FORMAT_Z_PIXMAP, dst_pm, 0, 0, dst_width, dst_height, (uint32_t)(~0UL));
+    xcb_render_free_picture(connection, dst_pict);
+    xcb_free_pixmap(connection, dst_pm);
+    xcb_get_image_reply_t *gi_reply = xcb_get_image_reply(connection, gi_cookie, &err);
+    xcbEventFilter::errorHandler("RenderScaler::Scale: get_image: ", &err);
+    err = xcb_request_check(connection, src_cookie);
+    if (xcbEventFilter::errorHandler("RenderScaler::Scale: create_picture: ", &err))
+    {
+        // then everything after it failed the same way, and the image is
+        // whatever the new pixmap happened to hold
+        for (int i = 0; i < 3; ++i) xcb_discard_reply(connection, uses[i].sequence);
+        free(gi_reply);
+        return ret;
+    }
+    xcb_render_free_picture(connection, src_pict);
+    bool failed = false;
+    for (int i = 0; i < 3; ++i)
+    {
+        err = xcb_request_check(connection, uses[i]);
+        if (xcbEventFilter::errorHandler("RenderScaler::Scale: ", &err)) failed = true;
+    }
+    if (failed || !gi_reply)
+    {
+        free(gi_reply);
+        return ret;
+    }
+    // a depth 24 source has no alpha, which render reads as opaque
+    PixelConvert::Layout layout;
+    layout.depth = 32;
+    layout.bits_per_pixel = 32;
+    layout.scanline_pad = 32;
+    layout.msb_first = (xcb_get_setup(connection)->image_byte_order == XCB_IMAGE_ORDER_MSB_FIRST);
+    layout.red_mask = 0xff0000;
+    layout.green_mask = 0xff00;
+    layout.blue_mask = 0xff;
+    layout.alpha_mask = 0xff000000U;
+    return PixelConvert::ToImage(xcb_get_image_data(gi_reply), xcb_get_image_data_length(gi_reply), dst_width, dst_height, layout, free, gi_reply);
+}
@@ -0,0 +1,47 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef RENDERSCALER_H
+#define RENDERSCALER_H
+
+#include <QImage>
+#include <QHash>
+#include <xcb/xcb.h>
+#include <xcb/render.h>
+
+// Scales a drawable down on the server with the RENDER extension and only
+// then pulls it over with get_image, so an icon costs kilobytes on the wire
+// instead of the whole window.  Meant for when the pixels can't come through
+// shared memory, i.e. remote displays.
+class RenderScaler
+{
+public:
+    explicit RenderScaler(xcb_connection_t *c);
+    bool IsAvailable() const { return available; }
+    // returns a Format_ARGB32_Premultiplied image of the drawable scaled to
+    // size, or a null image if the server couldn't do it
+    QImage Scale(xcb_drawable_t src, xcb_visualid_t visual, uint16_t src_width, uint16_t src_height, const QSize &size);
+
+private:
+    xcb_connection_t *connection;
+    bool available;
+    xcb_render_pictformat_t argb32_format;
+    QHash<xcb_visualid_t, xcb_render_pictformat_t> visual_formats;
+};
+
+#endif // RENDERSCALER_H
@@ -145,6 +145,26 @@ SettingsWindow::SettingsWindow(QWidget *parent) :
         bgColorPal->setColor(QPalette::Base, ib_bgcolor);
     }
     ui->BGColorLabel->setPalette(*bgColorPal);
+    // run the X event handling on its own thread and connection.  there's no
+    // widget for this one since it only takes effect at startup.
+    QString ib_event_thread = store->value("event_thread", QVariant("")).toString();
+    if (ib_event_thread != "true" && ib_event_thread != "false")
+    {
+        ib_event_thread = "false";
+        store->setValue("event_thread", QVariant("false"));
+    }
+    event_thread = (ib_event_thread == "true");
+    // how much memory finished icons can take, in KiB.  no widget either,
+    // nobody needs to touch this unless they've got a huge number of windows.
+    int ib_thumbnail_cache = store->value("thumbnail_cache_kb", QVariant(0)).toInt();
+    if (ib_thumbnail_cache < 256 || ib_thumbnail_cache > 1048576)
+    {
+        if (ib_thumbnail_cache <= 0) ib_thumbnail_cache = 16384;
+        else if (ib_thumbnail_cache < 256) ib_thumbnail_cache = 256;
+        else ib_thumbnail_cache = 1048576;
+        store->setValue("thumbnail_cache_kb", QVariant(ib_thumbnail_cache));
+    }
+    thumbnail_cache_kb = ib_thumbnail_cache;
 }
 
 SettingsWindow::~SettingsWindow()
@@ -257,6 +277,16 @@ QColor SettingsWindow::GetBackgroundColor() const
     return bgColorPal->color(QPalette::Base);
 }
 
+bool SettingsWindow::UsesEventThread() const
+{
+    return event_thread;
+}
+
+qint64 SettingsWindow::GetThumbnailCacheBytes() const
+{
+    return (qint64)thumbnail_cache_kb * 1024;
+}
+
 void SettingsWindow::changeEvent(QEvent *e)
 {
     QWidget::changeEvent(e);
@@ -45,6 +45,8 @@ public:
     bool IsFromLeft() const;
     bool IsTransparent() const;
     QColor GetBackgroundColor() const;
+    bool UsesEventThread() const;
+    qint64 GetThumbnailCacheBytes() const;
 
 signals:
     void settingsChanged();
@@ -70,6 +72,8 @@ private:
     Ui::SettingsWindow *ui;
     QSettings *store;
     QPalette *bgColorPal;
+    bool event_thread;
+    int thumbnail_cache_kb;
 };
 
 #endif // SETTINGSWINDOW_H
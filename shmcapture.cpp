@@ -0,0 +1,122 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "shmcapture.h"
+#include "xcbeventfilter.h"
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <QDebug>
+
+// what the first segment gets, which is also how we find out if shm works
+#define SHM_PROBE_BYTES (1024 * 1024)
+
+ShmCapture::ShmCapture(xcb_connection_t *c) :
+    connection(c), available(false), seg(0), shmid(-1), shmaddr(nullptr), capacity(0)
+{
+    xcb_generic_error_t *err = nullptr;
+    xcb_shm_query_version_cookie_t qv_cookie = xcb_shm_query_version(connection);
+    xcb_shm_query_version_reply_t *qv_reply = xcb_shm_query_version_reply(connection, qv_cookie, &err);
+    if (qv_reply)
+    {
+        available = true;
+        free(qv_reply);
+    }
+    // not having it isn't an error worth reporting
+    free(err);
+    // a remote server can have the extension and still not see our memory,
+    // which only shows when a segment gets attached.  better to find out
+    // now than on the first capture.
+    if (available) Reserve(SHM_PROBE_BYTES);
+}
+
+ShmCapture::~ShmCapture()
+{
+    Release();
+}
+
+const uchar *ShmCapture::GetImage(xcb_drawable_t drawable, uint16_t width, uint16_t height, const PixelConvert::Layout &layout, uint32_t *size)
+{
+    *size = 0;
+    // the server writes rows in the drawable's own format and padding
+    qint64 bytes = layout.IsValid() ? (qint64)layout.Stride(width) * height : 0;
+    if (!(available && bytes > 0 && bytes <= 0xffffffffLL && Reserve((uint32_t)bytes))) return nullptr;
+    xcb_generic_error_t *err = nullptr;
+    xcb_shm_get_image_cookie_t gi_cookie = xcb_shm_get_image(connection, drawable, 0, 0, width, height, (uint32_t)(~0UL), XCB_IMAGE_FORMAT_Z_PIXMAP, seg, 0);
+    xcb_shm_get_image_reply_t *gi_reply = xcb_shm_get_image_reply(connection, gi_cookie, &err);
+    xcbEventFilter::errorHandler("ShmCapture::GetImage: shm_get_image: ", &err);
+    if (!gi_reply) return nullptr;
+    uint32_t data_len = gi_reply->size;
+    free(gi_reply);
+    if (data_len > capacity) return nullptr;
+    *size = data_len;
+    return shmaddr;
+}
+
+bool ShmCapture::Reserve(uint32_t bytes)
+{
+    if (bytes <= capacity) return true;
+    Release();
+    // round up to a megabyte so a window that grows a little doesn't mean a new segment
+    uint32_t want = (bytes + 0xfffffU) & ~0xfffffU;
+    shmid = shmget(IPC_PRIVATE, want, IPC_CREAT | 0600);
+    if (shmid < 0)
+    {
+        qDebug() << "ShmCapture::Reserve: shmget failed for" << want << "bytes";
+        available = false;
+        return false;
+    }
+    void *addr = shmat(shmid, nullptr, 0);
+    if (addr == (void *)-1)
+    {
+        qDebug() << "ShmCapture::Reserve: shmat failed";
+        shmctl(shmid, IPC_RMID, nullptr);
+        shmid = -1;
+        available = false;
+        return false;
+    }
+    shmaddr = (uchar *)addr;
+    seg = xcb_generate_id(connection);
+    xcb_void_cookie_t void_cookie = xcb_shm_attach_checked(connection, seg, shmid, 0);
+    xcb_generic_error_t *err = xcb_request_check(connection, void_cookie);
+    // once the server has it attached nobody else needs to find it, and
+    // marking it now means it goes away even if we don't exit cleanly
+    shmctl(shmid, IPC_RMID, nullptr);
+    if (err)
+    {
+        // most likely a remote display; don't try again
+        free(err);
+        shmdt(shmaddr);
+        shmaddr = nullptr;
+        shmid = -1;
+        available = false;
+        return false;
+    }
+    capacity = want;
+    return true;
+}
+
+void ShmCapture::Release()
+{
+    if (!shmaddr) return;
+    // nobody waits on it, but a failure mustn't end up in someone's event queue
+    xcb_discard_reply(connection, xcb_shm_detach_checked(connection, seg).sequence);
+    shmdt(shmaddr);
+    shmaddr = nullptr;
+    shmid = -1;
+    capacity = 0;
+}
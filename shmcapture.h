@@ -0,0 +1,54 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SHMCAPTURE_H
+#define SHMCAPTURE_H
+
+#include <xcb/xcb.h>
+#include <xcb/shm.h>
+#include <QtGlobal>
+#include "pixelconvert.h"
+
+// Reads drawables through one MIT-SHM segment that's kept around and grown
+// as needed, so the pixels don't have to come through the socket.  Only of any
+// use on a local display; a segment is attached right away to find out, and
+// IsAvailable() is false if the server can't do it and callers should go
+// back to plain get_image.
+class ShmCapture
+{
+public:
+    explicit ShmCapture(xcb_connection_t *c);
+    ~ShmCapture();
+    bool IsAvailable() const { return available; }
+    // copies a Z pixmap image of the drawable, which is in layout, into the
+    // segment.  returns the pixels (good until the next call) or nullptr, and
+    // the byte count in *size.
+    const uchar *GetImage(xcb_drawable_t drawable, uint16_t width, uint16_t height, const PixelConvert::Layout &layout, uint32_t *size);
+
+private:
+    bool Reserve(uint32_t bytes);
+    void Release();
+    xcb_connection_t *connection;
+    bool available;
+    xcb_shm_seg_t seg;
+    int shmid;
+    uchar *shmaddr;
+    uint32_t capacity;
+};
+
+#endif // SHMCAPTURE_H
@@ -0,0 +1,76 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Fixed size ring for handing things from exactly one producer thread to
+// exactly one consumer thread without a lock.  Each side only ever writes its
+// own index, and the release/acquire pair on it is what publishes the slot.
+template <typename T, std::size_t N>
+class SpscRing
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+public:
+    SpscRing() : head(0), tail(0) { }
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    // producer side.  returns false (and leaves the ring alone) if it's full
+    bool Push(const T &item)
+    {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N) return false;
+        items[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side.  returns false if there was nothing to take
+    bool Pop(T &item)
+    {
+        std::size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        item = std::move(items[h & (N - 1)]);
+        // don't hang on to whatever the item owned until the slot gets reused
+        items[h & (N - 1)] = T();
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool IsEmpty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+private:
+    // keep the two indexes on separate cache lines so the threads don't
+    // keep stealing the line from each other.  padding rather than alignas,
+    // since these get allocated with plain new.
+    std::atomic<std::size_t> head;
+    char head_pad[64 - sizeof(std::atomic<std::size_t>)];
+    std::atomic<std::size_t> tail;
+    char tail_pad[64 - sizeof(std::atomic<std::size_t>)];
+    T items[N];
+};
+
+#endif // SPSCRING_H
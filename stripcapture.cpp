@@ -0,0 +1,106 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "stripcapture.h"
+#include "downscaler.h"
+#include "xcbeventfilter.h"
+#include <QQueue>
+#include <QDebug>
+#include <cstdlib>
+
+// requests the server is working on while we scale the last strip
+#define STRIP_IN_FLIGHT 2
+// with big requests a strip could be 16MB; that's more than a few strips
+// are supposed to cost
+#define STRIP_MAX_BYTES (4 * 1024 * 1024)
+// what a get_image reply has in front of the pixels
+#define STRIP_REPLY_HEADER 32
+
+namespace
+{
+    struct strip
+    {
+        xcb_get_image_cookie_t cookie;
+        int y, rows;
+    };
+
+    void FreeStrip(void *reply)
+    {
+        free(reply);
+    }
+}
+
+int StripCapture::RowsPerStrip(xcb_connection_t *c, const PixelConvert::Layout &layout, int width)
+{
+    return RowsPerStrip(xcb_get_maximum_request_length(c), layout, width);
+}
+
+int StripCapture::RowsPerStrip(uint32_t max_request_length, const PixelConvert::Layout &layout, int width)
+{
+    int stride = layout.IsValid() ? layout.Stride(width) : 0;
+    if (stride <= 0) return 0;
+    qint64 bytes = qMin((qint64)max_request_length * 4 - STRIP_REPLY_HEADER, (qint64)STRIP_MAX_BYTES);
+    return (int)qMax((qint64)1, bytes / stride);
+}
+
+QImage StripCapture::Capture(xcb_connection_t *c, xcb_drawable_t drawable, xcb_visualid_t visual, uint8_t depth,
+                             const QSize &src_size, const QSize &size)
+{
+    PixelConvert::Layout layout = PixelConvert::Describe(c, visual, depth);
+    int strip_rows = RowsPerStrip(c, layout, src_size.width());
+    if (!strip_rows) return QImage();
+    Downscaler::Stream stream(src_size, size);
+    QQueue<strip> in_flight;
+    int next_y = 0;
+    // keeps STRIP_IN_FLIGHT strips asked for ahead of the one being scaled
+    auto request_more = [&]()
+    {
+        while (next_y < src_size.height() && in_flight.count() < STRIP_IN_FLIGHT)
+        {
+            strip s;
+            s.y = next_y;
+            s.rows = qMin(strip_rows, src_size.height() - next_y);
+            s.cookie = xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, drawable, 0, s.y, src_size.width(), s.rows, (uint32_t)(~0UL));
+            in_flight.enqueue(s);
+            next_y += s.rows;
+        }
+    };
+    request_more();
+    bool ok = true;
+    while (ok && !in_flight.isEmpty())
+    {
+        strip s = in_flight.dequeue();
+        xcb_generic_error_t *err = nullptr;
+        xcb_get_image_reply_t *gi_reply = xcb_get_image_reply(c, s.cookie, &err);
+        if (!gi_reply)
+        {
+            xcbEventFilter::errorHandler("StripCapture::Capture: get_image: ", &err);
+            ok = false;
+            break;
+        }
+        // the server can get on with the next one while we scale this one
+        request_more();
+        QImage rows = PixelConvert::ToImage(xcb_get_image_data(gi_reply), xcb_get_image_data_length(gi_reply), src_size.width(), s.rows,
+                                            layout, FreeStrip, gi_reply);
+        ok = !rows.isNull() && stream.Feed(rows, s.y);
+    }
+    // nobody wants the rest
+    while (!in_flight.isEmpty()) xcb_discard_reply(c, in_flight.dequeue().cookie.sequence);
+    if (!ok) qDebug() << "StripCapture::Capture: gave up on" << src_size << "in strips of" << strip_rows << "rows";
+    return ok ? stream.Result() : QImage();
+}
@@ -0,0 +1,48 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef STRIPCAPTURE_H
+#define STRIPCAPTURE_H
+
+#include <QImage>
+#include <QSize>
+#include <xcb/xcb.h>
+#include "pixelconvert.h"
+
+// Plain get_image of a drawable a band of rows at a time.  One request for a
+// whole window that spans a few monitors can be more than the server takes
+// in one go, and it needs the whole frame in memory on our end.  Strips are
+// sized to fit in a request, the next ones are asked for before the one that
+// came back is dealt with, and each goes straight into a Downscaler::Stream,
+// so only a few of them are ever around at once.
+class StripCapture
+{
+public:
+    // how many rows of width pixels fit in one strip, at least 1 (or 0 if
+    // layout isn't valid)
+    static int RowsPerStrip(xcb_connection_t *c, const PixelConvert::Layout &layout, int width);
+    // the same for a server whose maximum request length, in 4 byte units,
+    // is max_request_length
+    static int RowsPerStrip(uint32_t max_request_length, const PixelConvert::Layout &layout, int width);
+    // the drawable's src_size pixels averaged down to size, which can't be
+    // any bigger; a null image if anything goes wrong
+    static QImage Capture(xcb_connection_t *c, xcb_drawable_t drawable, xcb_visualid_t visual, uint8_t depth,
+                          const QSize &src_size, const QSize &size);
+};
+
+#endif // STRIPCAPTURE_H
@@ -0,0 +1,121 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QX11Info>
+#include <xcb/xcb.h>
+#include <functional>
+#include "atomcache.h"
+
+// AtomCache on Qt's connection: Preload() interns every name it's given in
+// one go, and nothing it has seen costs a request afterwards.  Whatever it
+// hands out is checked against a connection of our own.
+class tst_AtomCache : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void preloadInternsAll();
+    void cachedAfterwards();
+    void namesBothWays();
+
+private:
+    // requests sent on Qt's connection while fn ran
+    static unsigned int RequestsDuring(const std::function<void()> &fn);
+    xcb_atom_t Intern(const QString &name);
+    xcb_connection_t *own;
+    QStringList names;
+};
+
+void tst_AtomCache::initTestCase()
+{
+    QVERIFY(QX11Info::connection());
+    own = xcb_connect(nullptr, nullptr);
+    QVERIFY(!xcb_connection_has_error(own));
+    // made up so nobody else has interned them before us
+    for (int i = 0; i < 40; ++i) names << QString("_WMIIB2_TEST_ATOM_%1_%2").arg(QCoreApplication::applicationPid()).arg(i);
+}
+
+void tst_AtomCache::cleanupTestCase()
+{
+    xcb_disconnect(own);
+}
+
+unsigned int tst_AtomCache::RequestsDuring(const std::function<void()> &fn)
+{
+    // every request gets the next sequence number, so two markers bracket them
+    xcb_connection_t *c = QX11Info::connection();
+    unsigned int first = xcb_get_input_focus(c).sequence;
+    xcb_discard_reply(c, first);
+    fn();
+    unsigned int last = xcb_get_input_focus(c).sequence;
+    xcb_discard_reply(c, last);
+    return last - first - 1;
+}
+
+xcb_atom_t tst_AtomCache::Intern(const QString &name)
+{
+    QByteArray n = name.toUtf8();
+    xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(own, xcb_intern_atom(own, 1, n.length(), n.constData()), nullptr);
+    xcb_atom_t ret = reply ? reply->atom : XCB_ATOM_NONE;
+    free(reply);
+    return ret;
+}
+
+void tst_AtomCache::preloadInternsAll()
+{
+    // one intern_atom per name, and a name twice is still asked for once
+    QStringList twice = names.mid(0, 20);
+    twice << names.at(0) << names.at(1);
+    QCOMPARE(RequestsDuring([&twice]() { AtomCache::Preload(twice); }), 20U);
+    // really interned, not just remembered
+    for (int i = 0; i < 20; ++i)
+    {
+        xcb_atom_t atom = Intern(names.at(i));
+        QVERIFY(atom != XCB_ATOM_NONE);
+        QCOMPARE(AtomCache::GetAtom(names.at(i)), atom);
+    }
+    // what's already in the cache isn't asked for again
+    QCOMPARE(RequestsDuring([this]() { AtomCache::Preload(names); }), 20U);
+}
+
+void tst_AtomCache::cachedAfterwards()
+{
+    QCOMPARE(RequestsDuring([this]() {
+        for (const QString &name : names) AtomCache::GetAtom(name);
+        for (const QString &name : names) AtomCache::GetAtomName(AtomCache::GetAtom(name));
+    }), 0U);
+    // an atom nobody asked about yet costs exactly one
+    QString fresh = names.last() + "_FRESH";
+    QCOMPARE(RequestsDuring([&fresh]() { AtomCache::GetAtom(fresh); }), 1U);
+    QCOMPARE(RequestsDuring([&fresh]() { AtomCache::GetAtom(fresh); }), 0U);
+}
+
+void tst_AtomCache::namesBothWays()
+{
+    // looked up by atom first, then by name for free
+    xcb_atom_t atom = Intern("_WMIIB2_TEST_BY_ATOM");
+    QCOMPARE(AtomCache::GetAtomName(atom), QString("_WMIIB2_TEST_BY_ATOM"));
+    QCOMPARE(RequestsDuring([atom]() { QCOMPARE(AtomCache::GetAtom("_WMIIB2_TEST_BY_ATOM"), atom); }), 0U);
+    QCOMPARE(AtomCache::GetAtomName(XCB_ATOM_WM_NAME), QString("WM_NAME"));
+}
+
+QTEST_MAIN(tst_AtomCache)
+
+#include "tst_atomcache.moc"
@@ -0,0 +1,87 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QImage>
+#include "downscaler.h"
+
+// Downscaler against QImage's own smooth scaling, from full screen sized
+// captures down to a 64 pixel icon.
+class bench_Downscaler : public QObject
+{
+    Q_OBJECT
+private slots:
+    void scale_data();
+    void scale();
+};
+
+namespace
+{
+    // something that isn't flat, so nothing gets to skip work
+    QImage Source(const QSize &size)
+    {
+        QImage img(size, QImage::Format_ARGB32_Premultiplied);
+        for (int y = 0; y < img.height(); ++y)
+        {
+            QRgb *line = (QRgb *)img.scanLine(y);
+            for (int x = 0; x < img.width(); ++x) line[x] = qRgba(x & 0xff, y & 0xff, (x ^ y) & 0xff, 0xff);
+        }
+        return img;
+    }
+}
+
+void bench_Downscaler::scale_data()
+{
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<bool>("qt");
+    const QSize sizes[] = { QSize(1920, 1080), QSize(3840, 2160), QSize(7680, 4320) };
+    const char *names[] = { "1080p", "4K", "8K" };
+    for (int i = 0; i < 3; ++i)
+    {
+        QTest::newRow(qPrintable(QString("%1 downscaler").arg(names[i]))) << sizes[i] << false;
+        QTest::newRow(qPrintable(QString("%1 qt smooth").arg(names[i]))) << sizes[i] << true;
+    }
+}
+
+void bench_Downscaler::scale()
+{
+    QFETCH(QSize, size);
+    QFETCH(bool, qt);
+    const int icon_size = 64;
+    QImage src = Source(size);
+    QImage icon;
+    if (qt)
+    {
+        QBENCHMARK
+        {
+            icon = src.scaled(icon_size, icon_size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        }
+    }
+    else
+    {
+        QBENCHMARK
+        {
+            icon = Downscaler::Scale(src, icon_size);
+        }
+    }
+    QCOMPARE(qMax(icon.width(), icon.height()), icon_size);
+}
+
+QTEST_GUILESS_MAIN(bench_Downscaler)
+
+#include "bench_downscaler.moc"
@@ -0,0 +1,81 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QImage>
+#include "pixelconvert.h"
+
+Q_DECLARE_METATYPE(PixelConvert::Layout)
+
+// ToImage throughput on a 1080p frame in each of the layouts the capture
+// path has to convert, plus the plain 32 bit one that only gets wrapped.
+class bench_PixelConvert : public QObject
+{
+    Q_OBJECT
+private slots:
+    void toImage_data();
+    void toImage();
+};
+
+namespace
+{
+    PixelConvert::Layout MakeLayout(uint8_t depth, uint8_t bpp, bool msb_first, uint32_t red, uint32_t green, uint32_t blue, uint32_t alpha)
+    {
+        PixelConvert::Layout layout;
+        layout.depth = depth;
+        layout.bits_per_pixel = bpp;
+        layout.scanline_pad = 32;
+        layout.msb_first = msb_first;
+        layout.red_mask = red;
+        layout.green_mask = green;
+        layout.blue_mask = blue;
+        layout.alpha_mask = alpha;
+        return layout;
+    }
+}
+
+void bench_PixelConvert::toImage_data()
+{
+    const bool native = (Q_BYTE_ORDER == Q_BIG_ENDIAN);
+    QTest::addColumn<PixelConvert::Layout>("layout");
+    QTest::newRow("16 bpp 565") << MakeLayout(16, 16, native, 0xf800, 0x07e0, 0x001f, 0);
+    QTest::newRow("24 bpp packed") << MakeLayout(24, 24, native, 0xff0000, 0xff00, 0xff, 0);
+    QTest::newRow("32 argb native") << MakeLayout(32, 32, native, 0xff0000, 0xff00, 0xff, 0xff000000U);
+    QTest::newRow("32 argb swapped") << MakeLayout(32, 32, !native, 0xff0000, 0xff00, 0xff, 0xff000000U);
+    QTest::newRow("depth 30") << MakeLayout(30, 32, native, 0x3ff00000, 0xffc00, 0x3ff, 0);
+}
+
+void bench_PixelConvert::toImage()
+{
+    QFETCH(PixelConvert::Layout, layout);
+    const int width = 1920, height = 1080;
+    int stride = layout.Stride(width);
+    QByteArray data(stride * height, 0);
+    // something that isn't flat
+    for (int i = 0; i < data.size(); ++i) data[i] = (char)(i * 7);
+    QImage img;
+    QBENCHMARK
+    {
+        img = PixelConvert::ToImage((const uchar *)data.constData(), data.size(), width, height, layout);
+    }
+    QCOMPARE(img.size(), QSize(width, height));
+}
+
+QTEST_GUILESS_MAIN(bench_PixelConvert)
+
+#include "bench_pixelconvert.moc"
@@ -0,0 +1,59 @@
+# Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+# This file is part of WMIIB2.
+
+# WMIIB2 is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# WMIIB2 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+
+include(../tests.pri)
+
+TARGET = tst_capturepool
+
+SOURCES += \
+    tst_capturepool.cpp \
+    ../../capturepool.cpp \
+    ../../capturecontext.cpp \
+    ../../wininfo.cpp \
+    ../../shmcapture.cpp \
+    ../../renderscaler.cpp \
+    ../../stripcapture.cpp \
+    ../../pixelconvert.cpp \
+    ../../downscaler.cpp \
+    ../../iconstore.cpp \
+    ../../netwmicon.cpp \
+    ../../xcbeventfilter.cpp \
+    ../../xcbreplyqueue.cpp \
+    ../../atomcache.cpp \
+    ../../ewmhatoms.cpp \
+    ../../logcategories.cpp
+
+HEADERS += \
+    ../../capturepool.h \
+    ../../capturecontext.h \
+    ../../wininfo.h \
+    ../../shmcapture.h \
+    ../../renderscaler.h \
+    ../../stripcapture.h \
+    ../../pixelconvert.h \
+    ../../downscaler.h \
+    ../../iconstore.h \
+    ../../netwmicon.h \
+    ../../xcbeventfilter.h \
+    ../../xcbreplyqueue.h \
+    ../../windowregistry.h \
+    ../../atomcache.h \
+    ../../ewmhatoms.h \
+    ../../logcategories.h
+
+RESOURCES += \
+    ../../resources.qrc
@@ -0,0 +1,187 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QSignalSpy>
+#include <QX11Info>
+#include <QVector>
+#include <xcb/xcb.h>
+#include <xcb/composite.h>
+#include "capturepool.h"
+#include "capturecontext.h"
+#include "ewmhatoms.h"
+
+// CapturePool against an unmapped window, which leaves only its own icon to
+// capture: the worker's result and the icons it fetched have to come back
+// together, and asking again for what's already running mustn't capture it
+// twice.  Also the pixmap a WinInfo names for a mapped window, which a copy
+// has to keep reading after the original has moved on.
+class tst_CapturePool : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void onePerRequest();
+    void keepsFetchedIcons();
+    void renamedPixmapOutlivesCopy();
+
+private:
+    // an unmapped window with a single size x size icon
+    xcb_window_t Window(quint32 size);
+    void Sync();
+    void SetIcon(xcb_window_t win, quint32 size);
+    xcb_connection_t *connection;
+    QVector<xcb_window_t> windows;
+};
+
+void tst_CapturePool::initTestCase()
+{
+    qRegisterMetaType<xcb_window_t>("xcb_window_t");
+    EwmhAtoms::Resolve();
+    // WinInfo reads the window's geometry through Qt's connection
+    connection = QX11Info::connection();
+    QVERIFY(connection);
+}
+
+void tst_CapturePool::cleanupTestCase()
+{
+    for (int i = 0; i < windows.count(); ++i) xcb_destroy_window(connection, windows.at(i));
+    xcb_flush(connection);
+}
+
+void tst_CapturePool::SetIcon(xcb_window_t win, quint32 size)
+{
+    QVector<quint32> words;
+    words << size << size;
+    for (quint32 i = 0; i < size * size; ++i) words << 0xff2040c0U;
+    xcb_change_property(connection, XCB_PROP_MODE_REPLACE, win, EwmhAtoms::Get(EwmhAtoms::NET_WM_ICON), XCB_ATOM_CARDINAL, 32, words.count(), words.constData());
+    Sync();
+}
+
+void tst_CapturePool::Sync()
+{
+    free(xcb_get_input_focus_reply(connection, xcb_get_input_focus(connection), nullptr));
+}
+
+xcb_window_t tst_CapturePool::Window(quint32 size)
+{
+    xcb_window_t win = xcb_generate_id(connection);
+    xcb_window_t root = xcb_setup_roots_iterator(xcb_get_setup(connection)).data->root;
+    xcb_create_window(connection, XCB_COPY_FROM_PARENT, win, root, 0, 0, 100, 50, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT, 0, nullptr);
+    SetIcon(win, size);
+    windows.append(win);
+    return win;
+}
+
+void tst_CapturePool::onePerRequest()
+{
+    xcb_window_t win = Window(48);
+    WinInfo info(win);
+    CapturePool pool;
+    QSignalSpy ready(&pool, SIGNAL(IconReady(xcb_window_t,quint32,quint32,int,QImage,WinInfo::IconFetch)));
+    pool.Request(win, 1, 1, 32, info, CapturePool::PRIORITY_VISIBLE);
+    // a worker has it already, so this is the same capture
+    pool.Request(win, 1, 1, 32, info, CapturePool::PRIORITY_VISIBLE);
+    QVERIFY(ready.wait(5000));
+    QTest::qWait(200);
+    QCOMPARE(ready.count(), 1);
+    QCOMPARE(pool.Pending(), 0);
+    QList<QVariant> args = ready.takeFirst();
+    QCOMPARE(args.at(0).value<xcb_window_t>(), win);
+    QImage icon = args.at(4).value<QImage>();
+    QCOMPARE(qMax(icon.width(), icon.height()), 32);
+    // newer contents while it's running are another capture
+    pool.Request(win, 1, 2, 32, info, CapturePool::PRIORITY_VISIBLE);
+    pool.Request(win, 1, 3, 32, info, CapturePool::PRIORITY_VISIBLE);
+    QVERIFY(ready.wait(5000));
+    while (pool.Pending()) QVERIFY(ready.wait(5000));
+    QCOMPARE(ready.count(), 2);
+    QCOMPARE(ready.last().at(2).toUInt(), 3U);
+}
+
+void tst_CapturePool::keepsFetchedIcons()
+{
+    xcb_window_t win = Window(48);
+    WinInfo info(win);
+    CapturePool pool;
+    QSignalSpy ready(&pool, SIGNAL(IconReady(xcb_window_t,quint32,quint32,int,QImage,WinInfo::IconFetch)));
+    pool.Request(win, 1, 1, 32, info, CapturePool::PRIORITY_VISIBLE);
+    QVERIFY(ready.wait(5000));
+    WinInfo::IconFetch fetch = ready.first().at(5).value<WinInfo::IconFetch>();
+    QVERIFY(fetch.fetched);
+    // unmapped, so all there was to go by is its icon
+    QVERIFY(!fetch.from_contents);
+    QVERIFY(fetch.icons);
+    QCOMPARE(fetch.icons->count(), 1);
+    QCOMPARE(fetch.icons->at(0).width(), 48);
+    info.KeepIcons(fetch);
+    // the kept icons get used as they are, without going back to the server
+    SetIcon(win, 24);
+    CaptureContext ctx(connection);
+    WinInfo::IconFetch again;
+    info.CaptureIcon(ctx, 32, &again);
+    QVERIFY(again.fetched);
+    QCOMPARE(again.icons.data(), fetch.icons.data());
+    // but not once the property has changed since they were fetched
+    info.IconChanged();
+    info.KeepIcons(fetch);
+    info.CaptureIcon(ctx, 32, &again);
+    QVERIFY(again.icons);
+    QCOMPARE(again.icons->at(0).width(), 24);
+}
+
+void tst_CapturePool::renamedPixmapOutlivesCopy()
+{
+    xcb_window_t win = Window(48);
+    uint32_t red = 0xff0000U;
+    xcb_change_window_attributes(connection, win, XCB_CW_BACK_PIXEL, &red);
+    xcb_composite_redirect_window(connection, win, XCB_COMPOSITE_REDIRECT_AUTOMATIC);
+    xcb_map_window(connection, win);
+    Sync();
+    WinInfo info(win);
+    QVERIFY(!info.HasPixmap());
+    WinInfo::PixmapRequest request = info.RequestPixmap();
+    Sync();
+    info.CollectPixmap(request);
+    QVERIFY(info.HasPixmap());
+    QCOMPARE(info.GetSize(), QSize(100, 50));
+    // once it's unmapped there's nothing left to name, but the copy a
+    // capture would have been handed still has the old pixmap
+    WinInfo copy = info;
+    xcb_unmap_window(connection, win);
+    request = info.RequestPixmap();
+    Sync();
+    info.CollectPixmap(request);
+    QVERIFY(!info.HasPixmap());
+    QVERIFY(copy.HasPixmap());
+    CaptureContext ctx(connection);
+    WinInfo::IconFetch fetch;
+    QImage icon = copy.CaptureIcon(ctx, 32, &fetch);
+    QCOMPARE(icon.size(), QSize(32, 16));
+    QCOMPARE(QColor(icon.pixel(16, 8)), QColor(Qt::red));
+    // nothing was fetched, the window's own icon wasn't needed
+    QVERIFY(fetch.from_contents);
+    QVERIFY(!fetch.fetched);
+    copy.Release();
+    QVERIFY(!copy.HasPixmap());
+}
+
+QTEST_MAIN(tst_CapturePool)
+
+#include "tst_capturepool.moc"
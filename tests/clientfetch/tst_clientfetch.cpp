@@ -0,0 +1,197 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QSignalSpy>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QSet>
+#include <xcb/xcb.h>
+#include "xcbeventfilter.h"
+#include "ewmhatoms.h"
+
+// How many requests it takes xcbEventFilter to pick up new clients.  Each
+// one should cost one fetch, so copying client_info around (into the
+// registry, on rehash) must never go back to the server.  The requests are
+// counted by sequence number on the filter's own connection.  Also a client
+// list too long to come back in one reply, and one that changes while the
+// filter is still reading it.
+class tst_ClientFetch : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void requestsPerClient();
+    void longList();
+    void listChangesBetweenPages();
+
+private:
+    // n plain windows, not listed anywhere yet
+    QVector<xcb_window_t> Windows(int n);
+    void SetClientList(const QVector<xcb_window_t> &wins);
+    void Destroy(const QVector<xcb_window_t> &wins);
+    // every window the spy has seen, once each
+    static QSet<xcb_window_t> Seen(const QSignalSpy &spy);
+    // requests the filter sends from Startup() until every one of n new
+    // clients has been announced, or -1 if they never all were
+    int RequestsFor(int n);
+    xcb_connection_t *connection;
+    xcb_window_t root;
+};
+
+void tst_ClientFetch::initTestCase()
+{
+    qRegisterMetaType<xcb_window_t>("xcb_window_t");
+    EwmhAtoms::Resolve();
+    connection = xcb_connect(nullptr, nullptr);
+    QVERIFY(!xcb_connection_has_error(connection));
+    root = xcb_setup_roots_iterator(xcb_get_setup(connection)).data->root;
+}
+
+void tst_ClientFetch::cleanupTestCase()
+{
+    xcb_delete_property(connection, root, EwmhAtoms::Get(EwmhAtoms::NET_CLIENT_LIST));
+    xcb_disconnect(connection);
+}
+
+QVector<xcb_window_t> tst_ClientFetch::Windows(int n)
+{
+    QVector<xcb_window_t> wins;
+    for (int i = 0; i < n; ++i)
+    {
+        xcb_window_t win = xcb_generate_id(connection);
+        xcb_create_window(connection, XCB_COPY_FROM_PARENT, win, root, 0, 0, 16, 16, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT, 0, nullptr);
+        wins.append(win);
+    }
+    return wins;
+}
+
+void tst_ClientFetch::SetClientList(const QVector<xcb_window_t> &wins)
+{
+    // listed the way a window manager would list them
+    xcb_change_property(connection, XCB_PROP_MODE_REPLACE, root, EwmhAtoms::Get(EwmhAtoms::NET_CLIENT_LIST), XCB_ATOM_WINDOW, 32, wins.count(), wins.constData());
+    free(xcb_get_input_focus_reply(connection, xcb_get_input_focus(connection), nullptr));
+}
+
+void tst_ClientFetch::Destroy(const QVector<xcb_window_t> &wins)
+{
+    for (xcb_window_t win : wins) xcb_destroy_window(connection, win);
+    free(xcb_get_input_focus_reply(connection, xcb_get_input_focus(connection), nullptr));
+}
+
+QSet<xcb_window_t> tst_ClientFetch::Seen(const QSignalSpy &spy)
+{
+    QSet<xcb_window_t> ret;
+    for (int i = 0; i < spy.count(); ++i) ret.insert(spy.at(i).at(0).value<xcb_window_t>());
+    return ret;
+}
+
+int tst_ClientFetch::RequestsFor(int n)
+{
+    QVector<xcb_window_t> wins = Windows(n);
+    SetClientList(wins);
+    xcb_connection_t *fc = xcb_connect(nullptr, nullptr);
+    if (xcb_connection_has_error(fc))
+    {
+        xcb_disconnect(fc);
+        return -1;
+    }
+    xcbEventFilter *filter = new xcbEventFilter(fc, true);
+    QSignalSpy mapped(filter, SIGNAL(WindowMapped(xcb_window_t,QString)));
+    // every request gets the next sequence number, so two markers bracket them
+    unsigned int first = xcb_get_input_focus(fc).sequence;
+    xcb_discard_reply(fc, first);
+    filter->Startup();
+    QElapsedTimer timer;
+    timer.start();
+    while (mapped.count() < n && timer.elapsed() < 5000) QTest::qWait(10);
+    unsigned int last = xcb_get_input_focus(fc).sequence;
+    xcb_discard_reply(fc, last);
+    int ret = (mapped.count() == n) ? (int)(last - first - 1) : -1;
+    delete filter;
+    Destroy(wins);
+    return ret;
+}
+
+void tst_ClientFetch::requestsPerClient()
+{
+    const int many = 32;
+    int one = RequestsFor(1);
+    int two = RequestsFor(2);
+    int lots = RequestsFor(many);
+    QVERIFY(one > 0 && two > 0 && lots > 0);
+    // Startup() and the batch fences cost the same however many clients
+    // there are, so the difference is what one client costs
+    int per_client = two - one;
+    QVERIFY(per_client > 0);
+    // SendFetch()'s five requests, creating the damage object and adding
+    // to the window's event mask
+    QVERIFY2(per_client <= 7, qPrintable(QString("%1 requests per client").arg(per_client)));
+    QCOMPARE(lots - one, (many - 1) * per_client);
+}
+
+void tst_ClientFetch::longList()
+{
+    // the first request asks for 256, so this takes a second one
+    QVector<xcb_window_t> wins = Windows(600);
+    SetClientList(wins);
+    xcb_connection_t *fc = xcb_connect(nullptr, nullptr);
+    QVERIFY(!xcb_connection_has_error(fc));
+    xcbEventFilter *filter = new xcbEventFilter(fc, true);
+    QSignalSpy mapped(filter, SIGNAL(WindowMapped(xcb_window_t,QString)));
+    filter->Startup();
+    QTRY_COMPARE_WITH_TIMEOUT(mapped.count(), wins.count(), 10000);
+    QCOMPARE(Seen(mapped), QSet<xcb_window_t>::fromList(wins.toList()));
+    // nobody twice
+    QTest::qWait(100);
+    QCOMPARE(mapped.count(), wins.count());
+    delete filter;
+    Destroy(wins);
+}
+
+void tst_ClientFetch::listChangesBetweenPages()
+{
+    QVector<xcb_window_t> before = Windows(600), after = Windows(300);
+    SetClientList(before);
+    xcb_connection_t *fc = xcb_connect(nullptr, nullptr);
+    QVERIFY(!xcb_connection_has_error(fc));
+    xcbEventFilter *filter = new xcbEventFilter(fc, true);
+    QSignalSpy mapped(filter, SIGNAL(WindowMapped(xcb_window_t,QString)));
+    QSignalSpy destroyed(filter, SIGNAL(WindowDestroyed(xcb_window_t)));
+    filter->Startup();
+    // wait for the server to have answered the first request without
+    // letting the filter see the answer, then swap the list out under it
+    free(xcb_get_input_focus_reply(fc, xcb_get_input_focus(fc), nullptr));
+    SetClientList(after);
+    // the first 256 of one list and the rest of the other would be 256
+    // windows that were already gone and 44 of after's.  it has to end up
+    // with exactly after, and never have shown anything else.
+    QTRY_COMPARE_WITH_TIMEOUT(mapped.count(), after.count(), 10000);
+    QTest::qWait(200);
+    QCOMPARE(Seen(mapped), QSet<xcb_window_t>::fromList(after.toList()));
+    QCOMPARE(mapped.count(), after.count());
+    QCOMPARE(destroyed.count(), 0);
+    delete filter;
+    Destroy(before);
+    Destroy(after);
+}
+
+QTEST_MAIN(tst_ClientFetch)
+
+#include "tst_clientfetch.moc"
@@ -0,0 +1,116 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QSignalSpy>
+#include <QElapsedTimer>
+#include <xcb/xcb.h>
+#include "xcbeventfilter.h"
+#include "ewmhatoms.h"
+
+// Drawing into a client has to come out of xcbEventFilter as WindowDamaged,
+// once per burst rather than once per request, and again for the next burst
+// once the damage has been taken off.  This is what the background
+// snapshots go by.
+class tst_Damage : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void damageIsReported();
+
+private:
+    // fills the client's whole area count times
+    void Draw(int count);
+    // waits until spy has at least n signals or the time is up
+    static bool WaitFor(QSignalSpy &spy, int n, int msec);
+    xcb_connection_t *connection;
+    xcb_window_t root, client;
+    xcb_gcontext_t gc;
+};
+
+void tst_Damage::initTestCase()
+{
+    qRegisterMetaType<xcb_window_t>("xcb_window_t");
+    EwmhAtoms::Resolve();
+    connection = xcb_connect(nullptr, nullptr);
+    QVERIFY(!xcb_connection_has_error(connection));
+    xcb_screen_t *screen = xcb_setup_roots_iterator(xcb_get_setup(connection)).data;
+    root = screen->root;
+    // with no window manager around, mapping it is all it takes to be drawn
+    client = xcb_generate_id(connection);
+    xcb_create_window(connection, XCB_COPY_FROM_PARENT, client, root, 0, 0, 64, 64, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT, 0, nullptr);
+    xcb_map_window(connection, client);
+    gc = xcb_generate_id(connection);
+    xcb_create_gc(connection, gc, client, XCB_GC_FOREGROUND, &screen->white_pixel);
+    xcb_change_property(connection, XCB_PROP_MODE_REPLACE, root, EwmhAtoms::Get(EwmhAtoms::NET_CLIENT_LIST), XCB_ATOM_WINDOW, 32, 1, &client);
+    free(xcb_get_input_focus_reply(connection, xcb_get_input_focus(connection), nullptr));
+}
+
+void tst_Damage::cleanupTestCase()
+{
+    xcb_delete_property(connection, root, EwmhAtoms::Get(EwmhAtoms::NET_CLIENT_LIST));
+    xcb_free_gc(connection, gc);
+    xcb_destroy_window(connection, client);
+    xcb_disconnect(connection);
+}
+
+void tst_Damage::Draw(int count)
+{
+    xcb_rectangle_t all = {0, 0, 64, 64};
+    for (int i = 0; i < count; ++i) xcb_poly_fill_rectangle(connection, client, gc, 1, &all);
+    xcb_flush(connection);
+}
+
+bool tst_Damage::WaitFor(QSignalSpy &spy, int n, int msec)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (spy.count() < n && timer.elapsed() < msec) QTest::qWait(10);
+    return spy.count() >= n;
+}
+
+void tst_Damage::damageIsReported()
+{
+    xcb_connection_t *fc = xcb_connect(nullptr, nullptr);
+    QVERIFY(!xcb_connection_has_error(fc));
+    xcbEventFilter *filter = new xcbEventFilter(fc, true);
+    QSignalSpy mapped(filter, SIGNAL(WindowMapped(xcb_window_t,QString)));
+    QSignalSpy damaged(filter, SIGNAL(WindowDamaged(xcb_window_t)));
+    filter->Startup();
+    QVERIFY(WaitFor(mapped, 1, 5000));
+    // whatever the map itself drew shouldn't be mistaken for what comes next
+    QTest::qWait(200);
+    damaged.clear();
+    Draw(50);
+    QVERIFY(WaitFor(damaged, 1, 5000));
+    QCOMPARE(damaged.first().at(0).value<xcb_window_t>(), client);
+    // the whole burst is one report, give or take where a flush fell
+    QTest::qWait(200);
+    int burst = damaged.count();
+    QVERIFY2(burst <= 2, qPrintable(QString("%1 reports for one burst").arg(burst)));
+    // and the next burst is reported too
+    Draw(1);
+    QVERIFY(WaitFor(damaged, burst + 1, 5000));
+    delete filter;
+}
+
+QTEST_MAIN(tst_Damage)
+
+#include "tst_damage.moc"
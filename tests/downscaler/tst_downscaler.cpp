@@ -0,0 +1,108 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QImage>
+#include "downscaler.h"
+
+// Downscaler::Stream fed a strip at a time has to come out exactly like
+// Downscaler::Scale on the whole image, wherever the strips happen to split
+// the blocks.
+class tst_Downscaler : public QObject
+{
+    Q_OBJECT
+private slots:
+    void streamMatchesScale_data();
+    void streamMatchesScale();
+    void streamRejectsBadFeeds();
+};
+
+namespace
+{
+    QImage Source(const QSize &size, QImage::Format format)
+    {
+        QImage img(size, QImage::Format_ARGB32_Premultiplied);
+        quint32 seed = 1;
+        for (int y = 0; y < img.height(); ++y)
+        {
+            QRgb *line = (QRgb *)img.scanLine(y);
+            for (int x = 0; x < img.width(); ++x)
+            {
+                seed = seed * 1103515245U + 12345U;
+                int a = (format == QImage::Format_RGB32) ? 0xff : (seed >> 24);
+                line[x] = qPremultiply(qRgba((seed >> 16) & 0xff, (seed >> 8) & 0xff, x & 0xff, a));
+            }
+        }
+        return img.convertToFormat(format);
+    }
+}
+
+void tst_Downscaler::streamMatchesScale_data()
+{
+    QTest::addColumn<QSize>("src_size");
+    QTest::addColumn<QSize>("size");
+    QTest::addColumn<int>("strip_rows");
+    QTest::addColumn<bool>("opaque");
+    QTest::newRow("row at a time") << QSize(200, 150) << QSize(64, 48) << 1 << true;
+    QTest::newRow("odd strips") << QSize(200, 150) << QSize(64, 48) << 7 << true;
+    QTest::newRow("odd strips, alpha") << QSize(200, 150) << QSize(64, 48) << 7 << false;
+    QTest::newRow("one strip") << QSize(333, 97) << QSize(50, 14) << 97 << false;
+    QTest::newRow("same size") << QSize(64, 40) << QSize(64, 40) << 16 << true;
+    // big enough that Scale() splits it across threads
+    QTest::newRow("threaded") << QSize(1600, 1200) << QSize(64, 48) << 100 << true;
+}
+
+void tst_Downscaler::streamMatchesScale()
+{
+    QFETCH(QSize, src_size);
+    QFETCH(QSize, size);
+    QFETCH(int, strip_rows);
+    QFETCH(bool, opaque);
+    QImage src = Source(src_size, opaque ? QImage::Format_RGB32 : QImage::Format_ARGB32_Premultiplied);
+    Downscaler::Stream stream(src_size, size);
+    for (int y = 0; y < src_size.height(); y += strip_rows)
+    {
+        int rows = qMin(strip_rows, src_size.height() - y);
+        QVERIFY(stream.Result().isNull());
+        QVERIFY(stream.Feed(src.copy(0, y, src_size.width(), rows), y));
+    }
+    QImage streamed = stream.Result();
+    QImage scaled = Downscaler::Scale(src, size);
+    QCOMPARE(streamed.size(), size);
+    QCOMPARE(streamed.format(), scaled.format());
+    QCOMPARE(streamed, scaled);
+}
+
+void tst_Downscaler::streamRejectsBadFeeds()
+{
+    QImage src = Source(QSize(100, 100), QImage::Format_RGB32);
+    Downscaler::Stream stream(QSize(100, 100), QSize(10, 10));
+    // out of order, the wrong width, or past the end
+    QVERIFY(!stream.Feed(src.copy(0, 10, 100, 10), 10));
+    QVERIFY(!stream.Feed(src.copy(0, 0, 50, 10), 0));
+    QVERIFY(stream.Feed(src.copy(0, 0, 100, 90), 0));
+    QVERIFY(!stream.Feed(src.copy(0, 90, 100, 20), 90));
+    QVERIFY(stream.Result().isNull());
+    // and it never grows anything
+    Downscaler::Stream up(QSize(10, 10), QSize(20, 20));
+    QVERIFY(!up.Feed(src.copy(0, 0, 10, 10), 0));
+}
+
+QTEST_GUILESS_MAIN(tst_Downscaler)
+
+#include "tst_downscaler.moc"
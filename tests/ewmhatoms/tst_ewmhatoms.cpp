@@ -0,0 +1,85 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QX11Info>
+#include <xcb/xcb.h>
+#include "ewmhatoms.h"
+#include "atomcache.h"
+
+// EwmhAtoms::Resolve() gets every atom the application knows about in one
+// batch on Qt's connection, and from then on Get() never goes near the
+// server.  The atoms are checked against a connection of our own.
+class tst_EwmhAtoms : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void resolvesAll();
+
+private:
+    xcb_connection_t *own;
+};
+
+void tst_EwmhAtoms::initTestCase()
+{
+    QVERIFY(QX11Info::connection());
+    own = xcb_connect(nullptr, nullptr);
+    QVERIFY(!xcb_connection_has_error(own));
+}
+
+void tst_EwmhAtoms::cleanupTestCase()
+{
+    xcb_disconnect(own);
+}
+
+void tst_EwmhAtoms::resolvesAll()
+{
+    xcb_connection_t *c = QX11Info::connection();
+    unsigned int first = xcb_get_input_focus(c).sequence;
+    xcb_discard_reply(c, first);
+    EwmhAtoms::Resolve();
+    unsigned int resolved = xcb_get_input_focus(c).sequence;
+    xcb_discard_reply(c, resolved);
+    // nothing was cached yet, so one intern_atom for each and nothing else
+    QCOMPARE(resolved - first - 1, (unsigned int)EwmhAtoms::ATOM_COUNT);
+    for (int i = 0; i < EwmhAtoms::ATOM_COUNT; ++i)
+    {
+        xcb_atom_t atom = EwmhAtoms::Get((EwmhAtoms::Id)i);
+        QVERIFY(atom != XCB_ATOM_NONE);
+        // the same atom under the name the table has for it
+        QString name = AtomCache::GetAtomName(atom);
+        QByteArray n = name.toUtf8();
+        xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(own, xcb_intern_atom(own, 1, n.length(), n.constData()), nullptr);
+        QVERIFY(reply);
+        QCOMPARE(reply->atom, atom);
+        free(reply);
+    }
+    QCOMPARE(EwmhAtoms::Get(EwmhAtoms::WM_NAME), (xcb_atom_t)XCB_ATOM_WM_NAME);
+    QCOMPARE(EwmhAtoms::Get(EwmhAtoms::WM_CLASS), (xcb_atom_t)XCB_ATOM_WM_CLASS);
+    QCOMPARE(EwmhAtoms::Get(EwmhAtoms::NET_CLIENT_LIST), AtomCache::GetAtom("_NET_CLIENT_LIST"));
+    // and after all that, still nothing sent
+    unsigned int last = xcb_get_input_focus(c).sequence;
+    xcb_discard_reply(c, last);
+    QCOMPARE(last - resolved - 1, 0U);
+}
+
+QTEST_MAIN(tst_EwmhAtoms)
+
+#include "tst_ewmhatoms.moc"
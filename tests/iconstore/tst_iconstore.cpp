@@ -0,0 +1,111 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QVector>
+#include <xcb/xcb.h>
+#include "iconstore.h"
+#include "ewmhatoms.h"
+
+// Windows of one application should end up holding the very same icons,
+// and the default icon should only be decoded and scaled once per size.
+class tst_IconStore : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void sharedPerClass();
+    void noIcon();
+    void defaultIcon();
+
+private:
+    // a window with the given WM_CLASS and a single size x size icon of
+    // argb, or no icon at all for size 0
+    xcb_window_t Window(const QByteArray &wm_class, quint32 size, quint32 argb);
+    xcb_connection_t *connection;
+    xcb_window_t root;
+    QVector<xcb_window_t> windows;
+};
+
+void tst_IconStore::initTestCase()
+{
+    EwmhAtoms::Resolve();
+    connection = xcb_connect(nullptr, nullptr);
+    QVERIFY(!xcb_connection_has_error(connection));
+    root = xcb_setup_roots_iterator(xcb_get_setup(connection)).data->root;
+}
+
+void tst_IconStore::cleanupTestCase()
+{
+    for (int i = 0; i < windows.count(); ++i) xcb_destroy_window(connection, windows.at(i));
+    xcb_disconnect(connection);
+}
+
+xcb_window_t tst_IconStore::Window(const QByteArray &wm_class, quint32 size, quint32 argb)
+{
+    xcb_window_t win = xcb_generate_id(connection);
+    xcb_create_window(connection, XCB_COPY_FROM_PARENT, win, root, 0, 0, 16, 16, 0, XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT, 0, nullptr);
+    xcb_change_property(connection, XCB_PROP_MODE_REPLACE, win, EwmhAtoms::Get(EwmhAtoms::WM_CLASS), XCB_ATOM_STRING, 8, wm_class.size(), wm_class.constData());
+    if (size)
+    {
+        QVector<quint32> words;
+        words << size << size;
+        for (quint32 i = 0; i < size * size; ++i) words << argb;
+        xcb_change_property(connection, XCB_PROP_MODE_REPLACE, win, EwmhAtoms::Get(EwmhAtoms::NET_WM_ICON), XCB_ATOM_CARDINAL, 32, words.count(), words.constData());
+    }
+    windows.append(win);
+    return win;
+}
+
+void tst_IconStore::sharedPerClass()
+{
+    const QByteArray term("term\0Term\0", 10), editor("edit\0Edit\0", 10);
+    IconStore::Icons a = IconStore::Get(connection, Window(term, 16, 0xff0000ffU));
+    IconStore::Icons b = IconStore::Get(connection, Window(term, 16, 0xff0000ffU));
+    QVERIFY(a);
+    QCOMPARE(a->count(), 1);
+    QCOMPARE(a->at(0).size(), QSize(16, 16));
+    QCOMPARE(a.data(), b.data());
+    // same pixels under another class, or another icon under the same
+    // class, are kept apart
+    IconStore::Icons c = IconStore::Get(connection, Window(editor, 16, 0xff0000ffU));
+    IconStore::Icons d = IconStore::Get(connection, Window(term, 16, 0xffff0000U));
+    QVERIFY(c && d);
+    QVERIFY(c.data() != a.data());
+    QVERIFY(d.data() != a.data());
+}
+
+void tst_IconStore::noIcon()
+{
+    QVERIFY(!IconStore::Get(connection, Window(QByteArray("bare\0Bare\0", 10), 0, 0)));
+}
+
+void tst_IconStore::defaultIcon()
+{
+    QImage full = IconStore::Default(0);
+    QVERIFY(!full.isNull());
+    QImage small = IconStore::Default(32);
+    QCOMPARE(qMax(small.width(), small.height()), 32);
+    // the second ask is the same image, not another scale
+    QCOMPARE(IconStore::Default(32).cacheKey(), small.cacheKey());
+}
+
+QTEST_MAIN(tst_IconStore)
+
+#include "tst_iconstore.moc"
@@ -0,0 +1,125 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QImage>
+#include <QVector>
+#include "netwmicon.h"
+
+// Parse() and Pick() on made up _NET_WM_ICON contents, no server needed.
+class tst_NetWmIcon : public QObject
+{
+    Q_OBJECT
+private slots:
+    void parse();
+    void premultiplies();
+    void stopsAtBadEntry();
+    void pick_data();
+    void pick();
+};
+
+namespace
+{
+    // width, height and then every pixel set to argb
+    void AddIcon(QVector<quint32> &words, quint32 width, quint32 height, quint32 argb)
+    {
+        words << width << height;
+        for (quint32 i = 0; i < width * height; ++i) words << argb;
+    }
+
+    QByteArray Raw(const QVector<quint32> &words)
+    {
+        return QByteArray((const char *)words.constData(), words.count() * 4);
+    }
+
+    QVector<QImage> Icons(const QVector<int> &sizes)
+    {
+        QVector<QImage> ret;
+        for (int i = 0; i < sizes.count(); ++i) ret << QImage(sizes.at(i), sizes.at(i), QImage::Format_ARGB32_Premultiplied);
+        return ret;
+    }
+}
+
+void tst_NetWmIcon::parse()
+{
+    QVector<quint32> words;
+    AddIcon(words, 16, 16, 0xff112233U);
+    AddIcon(words, 32, 24, 0xff445566U);
+    QVector<QImage> icons = NetWmIcon::Parse(Raw(words));
+    QCOMPARE(icons.count(), 2);
+    QCOMPARE(icons.at(0).size(), QSize(16, 16));
+    QCOMPARE(icons.at(1).size(), QSize(32, 24));
+    QCOMPARE(icons.at(1).format(), QImage::Format_ARGB32_Premultiplied);
+    QCOMPARE(icons.at(1).pixel(31, 23), 0xff445566U);
+    QVERIFY(NetWmIcon::Parse(QByteArray()).isEmpty());
+}
+
+void tst_NetWmIcon::premultiplies()
+{
+    // 5 wide so both the 4 at a time path and the leftover one get used
+    QVector<quint32> words;
+    AddIcon(words, 5, 2, 0x80ff4000U);
+    QVector<QImage> icons = NetWmIcon::Parse(Raw(words));
+    QCOMPARE(icons.count(), 1);
+    for (int y = 0; y < 2; ++y)
+    {
+        const quint32 *line = (const quint32 *)icons.at(0).constScanLine(y);
+        for (int x = 0; x < 5; ++x) QCOMPARE(line[x], 0x80802000U);
+    }
+}
+
+void tst_NetWmIcon::stopsAtBadEntry()
+{
+    QVector<quint32> words;
+    AddIcon(words, 2, 2, 0xffffffffU);
+    // claims more pixels than are left
+    words << 64 << 64 << 0 << 0;
+    QVector<QImage> icons = NetWmIcon::Parse(Raw(words));
+    QCOMPARE(icons.count(), 1);
+    QCOMPARE(icons.at(0).size(), QSize(2, 2));
+    // and nothing comes of an empty one
+    words.clear();
+    words << 0 << 16;
+    AddIcon(words, 2, 2, 0xffffffffU);
+    QVERIFY(NetWmIcon::Parse(Raw(words)).isEmpty());
+}
+
+void tst_NetWmIcon::pick_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<int>("expected");
+    QTest::newRow("between") << 24 << 32;
+    QTest::newRow("exact") << 32 << 32;
+    QTest::newRow("smallest") << 8 << 16;
+    QTest::newRow("too big") << 64 << 48;
+    QTest::newRow("biggest") << 0 << 48;
+}
+
+void tst_NetWmIcon::pick()
+{
+    QFETCH(int, size);
+    QFETCH(int, expected);
+    // the order the property lists them in shouldn't matter
+    QVector<QImage> icons = Icons(QVector<int>() << 32 << 48 << 16);
+    QCOMPARE(NetWmIcon::Pick(icons, size).width(), expected);
+    QVERIFY(NetWmIcon::Pick(QVector<QImage>(), size).isNull());
+}
+
+QTEST_GUILESS_MAIN(tst_NetWmIcon)
+
+#include "tst_netwmicon.moc"
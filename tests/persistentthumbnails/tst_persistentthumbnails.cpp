@@ -0,0 +1,171 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include "persistentthumbnails.h"
+
+// Icons written by one run have to come back in the next, but only for the
+// same window of the same owner, and only through Loaded().  Runs against
+// Qt's test mode cache directory, which starts out empty.
+class tst_PersistentThumbnails : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void roundTrip();
+    void otherIdentity();
+    void otherWindow();
+    void remove();
+    void badArguments();
+    void loadsInOrder();
+
+private:
+    QString Path(xcb_window_t win) const;
+    QString dir;
+};
+
+namespace
+{
+    QImage Icon(const QSize &size)
+    {
+        QImage img(size, QImage::Format_ARGB32_Premultiplied);
+        for (int y = 0; y < img.height(); ++y)
+        {
+            QRgb *line = (QRgb *)img.scanLine(y);
+            for (int x = 0; x < img.width(); ++x) line[x] = qPremultiply(qRgba(x * 5, y * 7, x ^ y, 0x80 + x));
+        }
+        return img;
+    }
+
+    QByteArray Identity(char fill)
+    {
+        return QByteArray(20, fill);
+    }
+
+    // what Loaded() handed over once everything queued is done, or a null image
+    QImage Load(PersistentThumbnails &saved, xcb_window_t win, const QByteArray &identity)
+    {
+        QSignalSpy loaded(&saved, SIGNAL(Loaded(uint,QByteArray,QImage)));
+        saved.Load(win, identity);
+        saved.Flush();
+        if (loaded.count() != 1) return QImage();
+        QList<QVariant> args = loaded.takeFirst();
+        if (args.at(0).toUInt() != win || args.at(1).toByteArray() != identity) return QImage();
+        return args.at(2).value<QImage>();
+    }
+}
+
+void tst_PersistentThumbnails::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/thumbnails";
+    QDir(dir).removeRecursively();
+}
+
+QString tst_PersistentThumbnails::Path(xcb_window_t win) const
+{
+    return dir + QString("/%1.thumb").arg(win, 8, 16, QChar('0'));
+}
+
+void tst_PersistentThumbnails::roundTrip()
+{
+    PersistentThumbnails saved;
+    QVERIFY(saved.IsAvailable());
+    QImage icon = Icon(QSize(48, 30));
+    saved.Store(0x1200001, Identity('a'), icon);
+    saved.Flush();
+    QVERIFY(QFile::exists(Path(0x1200001)));
+    // another run
+    PersistentThumbnails next;
+    QImage loaded = Load(next, 0x1200001, Identity('a'));
+    QCOMPARE(loaded.format(), QImage::Format_ARGB32_Premultiplied);
+    QCOMPARE(loaded, icon);
+}
+
+void tst_PersistentThumbnails::otherIdentity()
+{
+    PersistentThumbnails saved;
+    saved.Store(0x1200002, Identity('a'), Icon(QSize(16, 16)));
+    saved.Flush();
+    QVERIFY(Load(saved, 0x1200002, Identity('b')).isNull());
+    // and a file that didn't match is gone for good
+    QVERIFY(!QFile::exists(Path(0x1200002)));
+    QVERIFY(Load(saved, 0x1200002, Identity('a')).isNull());
+}
+
+void tst_PersistentThumbnails::otherWindow()
+{
+    PersistentThumbnails saved;
+    saved.Store(0x1200003, Identity('a'), Icon(QSize(16, 16)));
+    saved.Flush();
+    QVERIFY(Load(saved, 0x1200004, Identity('a')).isNull());
+    // a file under another window's name is turned down by its header
+    QVERIFY(QFile::copy(Path(0x1200003), Path(0x1200004)));
+    QVERIFY(Load(saved, 0x1200004, Identity('a')).isNull());
+    QVERIFY(!Load(saved, 0x1200003, Identity('a')).isNull());
+}
+
+void tst_PersistentThumbnails::remove()
+{
+    PersistentThumbnails saved;
+    saved.Store(0x1200005, Identity('a'), Icon(QSize(16, 16)));
+    // queued behind the write, so it can't be undone by it
+    saved.Remove(0x1200005);
+    saved.Flush();
+    QVERIFY(!QFile::exists(Path(0x1200005)));
+    QVERIFY(Load(saved, 0x1200005, Identity('a')).isNull());
+}
+
+void tst_PersistentThumbnails::badArguments()
+{
+    PersistentThumbnails saved;
+    saved.Store(0x1200006, QByteArray("short"), Icon(QSize(16, 16)));
+    saved.Store(0x1200007, Identity('a'), Icon(QSize(2000, 10)));
+    saved.Store(0x1200008, Identity('a'), QImage());
+    saved.Flush();
+    QVERIFY(!QFile::exists(Path(0x1200006)));
+    QVERIFY(!QFile::exists(Path(0x1200007)));
+    QVERIFY(!QFile::exists(Path(0x1200008)));
+    QVERIFY(Load(saved, 0x1200006, QByteArray("short")).isNull());
+}
+
+void tst_PersistentThumbnails::loadsInOrder()
+{
+    // asked for before the write is done, but it waits its turn
+    PersistentThumbnails saved;
+    QSignalSpy loaded(&saved, SIGNAL(Loaded(uint,QByteArray,QImage)));
+    QImage icon = Icon(QSize(20, 20));
+    saved.Store(0x1200009, Identity('a'), icon);
+    saved.Load(0x1200009, Identity('a'));
+    // and a mismatch removes the file behind the load, not before it
+    saved.Load(0x1200009, Identity('b'));
+    saved.Load(0x1200009, Identity('a'));
+    saved.Flush();
+    QCOMPARE(loaded.count(), 1);
+    QCOMPARE(loaded.first().at(2).value<QImage>(), icon);
+    QVERIFY(!QFile::exists(Path(0x1200009)));
+}
+
+QTEST_GUILESS_MAIN(tst_PersistentThumbnails)
+
+#include "tst_persistentthumbnails.moc"
@@ -0,0 +1,179 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QImage>
+#include "pixelconvert.h"
+
+// ToImage on hand made buffers, one for each kind of layout a server is
+// likely to hand us.
+class tst_PixelConvert : public QObject
+{
+    Q_OBJECT
+private slots:
+    void rgb565();
+    void packed24();
+    void native32Wraps();
+    void swapped32();
+    void premultipliedClamp();
+    void depth30();
+    void shortBuffer();
+};
+
+namespace
+{
+    PixelConvert::Layout MakeLayout(uint8_t depth, uint8_t bpp, bool msb_first, uint32_t red, uint32_t green, uint32_t blue, uint32_t alpha = 0)
+    {
+        PixelConvert::Layout layout;
+        layout.depth = depth;
+        layout.bits_per_pixel = bpp;
+        layout.scanline_pad = 32;
+        layout.msb_first = msb_first;
+        layout.red_mask = red;
+        layout.green_mask = green;
+        layout.blue_mask = blue;
+        layout.alpha_mask = alpha;
+        return layout;
+    }
+
+    // writes the low bytes of v in the layout's byte order
+    void Put(QByteArray &buf, int offset, uint32_t v, int bytes, bool msb_first)
+    {
+        for (int i = 0; i < bytes; ++i)
+        {
+            int shift = msb_first ? 8 * (bytes - 1 - i) : 8 * i;
+            buf[offset + i] = (char)((v >> shift) & 0xff);
+        }
+    }
+
+    void CountCleanup(void *info)
+    {
+        ++*static_cast<int *>(info);
+    }
+}
+
+void tst_PixelConvert::rgb565()
+{
+    PixelConvert::Layout layout = MakeLayout(16, 16, false, 0xf800, 0x07e0, 0x001f);
+    // 4 pixels is 8 bytes, already a multiple of the pad
+    QCOMPARE(layout.Stride(4), 8);
+    QByteArray buf(8, 0);
+    Put(buf, 0, 0xf800, 2, false);
+    Put(buf, 2, 0x07e0, 2, false);
+    Put(buf, 4, 0x001f, 2, false);
+    Put(buf, 6, 0x8410, 2, false);
+    QImage img = PixelConvert::ToImage((const uchar *)buf.constData(), buf.size(), 4, 1, layout);
+    QCOMPARE(img.format(), QImage::Format_RGB32);
+    QCOMPARE(img.pixel(0, 0), qRgb(0xff, 0, 0));
+    QCOMPARE(img.pixel(1, 0), qRgb(0, 0xff, 0));
+    QCOMPARE(img.pixel(2, 0), qRgb(0, 0, 0xff));
+    // half way gets its top bits repeated into the low ones
+    QCOMPARE(img.pixel(3, 0), qRgb(0x84, 0x82, 0x84));
+}
+
+void tst_PixelConvert::packed24()
+{
+    PixelConvert::Layout layout = MakeLayout(24, 24, true, 0xff0000, 0xff00, 0xff);
+    // 3 pixels is 9 bytes, padded to 12
+    QCOMPARE(layout.Stride(3), 12);
+    QByteArray buf(24, (char)0xee);
+    for (int y = 0; y < 2; ++y)
+    {
+        for (int x = 0; x < 3; ++x) Put(buf, y * 12 + x * 3, (x * 0x40) << 16 | (y * 0x80) << 8 | 0x11, 3, true);
+    }
+    QImage img = PixelConvert::ToImage((const uchar *)buf.constData(), buf.size(), 3, 2, layout);
+    QCOMPARE(img.size(), QSize(3, 2));
+    for (int y = 0; y < 2; ++y)
+    {
+        for (int x = 0; x < 3; ++x) QCOMPARE(img.pixel(x, y), qRgb(x * 0x40, y * 0x80, 0x11));
+    }
+}
+
+void tst_PixelConvert::native32Wraps()
+{
+    PixelConvert::Layout layout = MakeLayout(24, 32, Q_BYTE_ORDER == Q_BIG_ENDIAN, 0xff0000, 0xff00, 0xff);
+    QVector<quint32> buf(4, 0xff123456U);
+    int cleaned = 0;
+    {
+        QImage img = PixelConvert::ToImage((const uchar *)buf.constData(), buf.size() * 4, 2, 2, layout, CountCleanup, &cleaned);
+        // nothing to convert, so it's the same memory
+        QCOMPARE(img.constBits(), (const uchar *)buf.constData());
+        QCOMPARE(img.pixel(1, 1), qRgb(0x12, 0x34, 0x56));
+        QCOMPARE(cleaned, 0);
+    }
+    QCOMPARE(cleaned, 1);
+}
+
+void tst_PixelConvert::swapped32()
+{
+    bool msb_first = (Q_BYTE_ORDER != Q_BIG_ENDIAN);
+    PixelConvert::Layout layout = MakeLayout(32, 32, msb_first, 0xff0000, 0xff00, 0xff, 0xff000000U);
+    QByteArray buf(4, 0);
+    Put(buf, 0, 0xff102030U, 4, msb_first);
+    int cleaned = 0;
+    QImage img = PixelConvert::ToImage((const uchar *)buf.constData(), buf.size(), 1, 1, layout, CountCleanup, &cleaned);
+    QCOMPARE(img.format(), QImage::Format_ARGB32_Premultiplied);
+    QVERIFY(img.constBits() != (const uchar *)buf.constData());
+    // a converted copy doesn't need the data past the call
+    QCOMPARE(cleaned, 1);
+    QCOMPARE(img.pixel(0, 0), qRgba(0x10, 0x20, 0x30, 0xff));
+}
+
+void tst_PixelConvert::premultipliedClamp()
+{
+    // big endian words so the byte order never matches and it converts
+    PixelConvert::Layout layout = MakeLayout(32, 32, true, 0xff0000, 0xff00, 0xff, 0xff000000U);
+    if (Q_BYTE_ORDER == Q_BIG_ENDIAN) layout.msb_first = false;
+    QByteArray buf(4, 0);
+    Put(buf, 0, 0x80ff4020U, 4, layout.msb_first);
+    QImage img = PixelConvert::ToImage((const uchar *)buf.constData(), buf.size(), 1, 1, layout);
+    // red can't be brighter than the alpha it's been multiplied by
+    QRgb p = ((const QRgb *)img.constBits())[0];
+    QCOMPARE(qAlpha(p), 0x80);
+    QCOMPARE(qRed(p), 0x80);
+    QCOMPARE(qGreen(p), 0x40);
+    QCOMPARE(qBlue(p), 0x20);
+}
+
+void tst_PixelConvert::depth30()
+{
+    PixelConvert::Layout layout = MakeLayout(30, 32, false, 0x3ff00000, 0xffc00, 0x3ff);
+    QByteArray buf(8, 0);
+    Put(buf, 0, 0x3ffU << 20 | 0x200U << 10 | 0x0ffU, 4, false);
+    Put(buf, 4, 0x3ffU, 4, false);
+    QImage img = PixelConvert::ToImage((const uchar *)buf.constData(), buf.size(), 2, 1, layout);
+    QCOMPARE(img.format(), QImage::Format_RGB32);
+    // the low 2 bits of each channel just fall off
+    QCOMPARE(img.pixel(0, 0), qRgb(0xff, 0x80, 0x3f));
+    QCOMPARE(img.pixel(1, 0), qRgb(0, 0, 0xff));
+}
+
+void tst_PixelConvert::shortBuffer()
+{
+    PixelConvert::Layout layout = MakeLayout(24, 32, false, 0xff0000, 0xff00, 0xff);
+    QByteArray buf(15, 0);
+    int cleaned = 0;
+    QImage img = PixelConvert::ToImage((const uchar *)buf.constData(), buf.size(), 2, 2, layout, CountCleanup, &cleaned);
+    QVERIFY(img.isNull());
+    QCOMPARE(cleaned, 1);
+    QVERIFY(PixelConvert::ToImage((const uchar *)buf.constData(), buf.size(), 1, 1, PixelConvert::Layout()).isNull());
+}
+
+QTEST_GUILESS_MAIN(tst_PixelConvert)
+
+#include "tst_pixelconvert.moc"
@@ -0,0 +1,111 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <xcb/xcb.h>
+#include "renderscaler.h"
+
+// RenderScaler against a pixmap with known contents: the server should hand
+// back something small that still looks like the source, and nothing at all
+// when it can't read the source.
+class tst_RenderScaler : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void scalesDown();
+    void unknownVisual();
+    void badSource();
+
+private:
+    xcb_connection_t *connection;
+    xcb_screen_t *screen;
+};
+
+void tst_RenderScaler::initTestCase()
+{
+    connection = xcb_connect(nullptr, nullptr);
+    QVERIFY(!xcb_connection_has_error(connection));
+    screen = xcb_setup_roots_iterator(xcb_get_setup(connection)).data;
+}
+
+void tst_RenderScaler::cleanupTestCase()
+{
+    xcb_disconnect(connection);
+}
+
+void tst_RenderScaler::scalesDown()
+{
+    RenderScaler scaler(connection);
+    if (!scaler.IsAvailable()) QSKIP("the server has no usable RENDER");
+    // left half red, right half blue
+    const uint16_t width = 512, height = 256;
+    xcb_pixmap_t pm = xcb_generate_id(connection);
+    xcb_create_pixmap(connection, screen->root_depth, pm, screen->root, width, height);
+    xcb_gcontext_t gc = xcb_generate_id(connection);
+    uint32_t red = 0xff0000, blue = 0x0000ff;
+    xcb_create_gc(connection, gc, pm, XCB_GC_FOREGROUND, &red);
+    xcb_rectangle_t left = {0, 0, (uint16_t)(width / 2), height};
+    xcb_poly_fill_rectangle(connection, pm, gc, 1, &left);
+    xcb_change_gc(connection, gc, XCB_GC_FOREGROUND, &blue);
+    xcb_rectangle_t right = {(int16_t)(width / 2), 0, (uint16_t)(width / 2), height};
+    xcb_poly_fill_rectangle(connection, pm, gc, 1, &right);
+    QImage img = scaler.Scale(pm, screen->root_visual, width, height, QSize(32, 16));
+    xcb_free_gc(connection, gc);
+    xcb_free_pixmap(connection, pm);
+    QVERIFY(!img.isNull());
+    // a little bigger than asked for so the final pass has something to
+    // average, but nowhere near the source
+    QVERIFY(img.width() >= 32 && img.width() < width / 4);
+    QVERIFY(img.height() >= 16 && img.height() < height / 4);
+    QCOMPARE(img.format(), QImage::Format_ARGB32_Premultiplied);
+    // away from the seam it's still solid, and a depth 24 source is opaque
+    QRgb l = img.pixel(2, img.height() / 2), r = img.pixel(img.width() - 3, img.height() / 2);
+    QCOMPARE(qAlpha(l), 0xff);
+    QVERIFY(qRed(l) > 0xf0 && qBlue(l) < 0x10);
+    QVERIFY(qBlue(r) > 0xf0 && qRed(r) < 0x10);
+}
+
+void tst_RenderScaler::unknownVisual()
+{
+    RenderScaler scaler(connection);
+    QVERIFY(scaler.Scale(screen->root, 0, 64, 64, QSize(16, 16)).isNull());
+    QVERIFY(scaler.Scale(screen->root, screen->root_visual, 64, 64, QSize()).isNull());
+}
+
+void tst_RenderScaler::badSource()
+{
+    RenderScaler scaler(connection);
+    if (!scaler.IsAvailable()) QSKIP("the server has no usable RENDER");
+    // a depth 1 pixmap doesn't match the root visual's format, so the source
+    // picture can't be made even though the destination can
+    xcb_pixmap_t pm = xcb_generate_id(connection);
+    xcb_create_pixmap(connection, 1, pm, screen->root, 64, 64);
+    QVERIFY(scaler.Scale(pm, screen->root_visual, 64, 64, QSize(16, 16)).isNull());
+    xcb_free_pixmap(connection, pm);
+    // and it still works afterwards
+    pm = xcb_generate_id(connection);
+    xcb_create_pixmap(connection, screen->root_depth, pm, screen->root, 64, 64);
+    QVERIFY(!scaler.Scale(pm, screen->root_visual, 64, 64, QSize(16, 16)).isNull());
+    xcb_free_pixmap(connection, pm);
+}
+
+QTEST_GUILESS_MAIN(tst_RenderScaler)
+
+#include "tst_renderscaler.moc"
@@ -0,0 +1,195 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QByteArray>
+#include <xcb/xcb.h>
+#include <xcb/shm.h>
+#include "shmcapture.h"
+
+// ShmCapture against plain get_image of the same pixmap: the same bytes
+// either way, including once the segment has had to grow past the 1MB it
+// starts with, and nothing at all when the server can't do shared memory.
+// The benchmarks are the two side by side at a typical window size.
+class tst_ShmCapture : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void probe();
+    void unavailable();
+    void matchesGetImage_data();
+    void matchesGetImage();
+    void badDrawable();
+    void benchShm();
+    void benchGetImage();
+
+private:
+    // a pixmap the size given with stripes of a few colors in it
+    xcb_pixmap_t Pixmap(uint16_t width, uint16_t height);
+    QByteArray GetImage(xcb_pixmap_t pm, uint16_t width, uint16_t height);
+    bool HasShm() const;
+    xcb_connection_t *connection;
+    xcb_screen_t *screen;
+    PixelConvert::Layout layout;
+    ShmCapture *shared;
+};
+
+void tst_ShmCapture::initTestCase()
+{
+    connection = xcb_connect(nullptr, nullptr);
+    QVERIFY(!xcb_connection_has_error(connection));
+    screen = xcb_setup_roots_iterator(xcb_get_setup(connection)).data;
+    layout = PixelConvert::Describe(connection, screen->root_visual, screen->root_depth);
+    QVERIFY(layout.IsValid());
+    shared = new ShmCapture(connection);
+}
+
+void tst_ShmCapture::cleanupTestCase()
+{
+    delete shared;
+    xcb_disconnect(connection);
+}
+
+bool tst_ShmCapture::HasShm() const
+{
+    const xcb_query_extension_reply_t *ext = xcb_get_extension_data(connection, &xcb_shm_id);
+    return ext && ext->present;
+}
+
+xcb_pixmap_t tst_ShmCapture::Pixmap(uint16_t width, uint16_t height)
+{
+    xcb_pixmap_t pm = xcb_generate_id(connection);
+    xcb_create_pixmap(connection, screen->root_depth, pm, screen->root, width, height);
+    xcb_gcontext_t gc = xcb_generate_id(connection);
+    xcb_create_gc(connection, gc, pm, 0, nullptr);
+    const uint32_t colors[] = { 0xff0000, 0x00ff00, 0x0000ff, 0x123456, 0xfedcba };
+    for (int i = 0; i * 7 < width; ++i)
+    {
+        xcb_change_gc(connection, gc, XCB_GC_FOREGROUND, &colors[i % 5]);
+        xcb_rectangle_t stripe = {(int16_t)(i * 7), 0, 7, height};
+        xcb_poly_fill_rectangle(connection, pm, gc, 1, &stripe);
+    }
+    xcb_free_gc(connection, gc);
+    return pm;
+}
+
+QByteArray tst_ShmCapture::GetImage(xcb_pixmap_t pm, uint16_t width, uint16_t height)
+{
+    xcb_get_image_reply_t *reply = xcb_get_image_reply(connection, xcb_get_image(connection, XCB_IMAGE_FORMAT_Z_PIXMAP, pm, 0, 0, width, height, (uint32_t)(~0UL)), nullptr);
+    if (!reply) return QByteArray();
+    QByteArray ret((const char *)xcb_get_image_data(reply), xcb_get_image_data_length(reply));
+    free(reply);
+    return ret;
+}
+
+void tst_ShmCapture::probe()
+{
+    // the constructor attaches a segment to find out, so by now it knows
+    ShmCapture shm(connection);
+    if (!HasShm()) QSKIP("the server has no MIT-SHM");
+    QVERIFY(shm.IsAvailable());
+}
+
+void tst_ShmCapture::unavailable()
+{
+    ShmCapture shm(connection);
+    if (HasShm()) QSKIP("the server has MIT-SHM; run under xvfb-run -s '-extension MIT-SHM' to see it without");
+    // callers go back to get_image on this alone
+    QVERIFY(!shm.IsAvailable());
+    uint32_t size = 1;
+    QVERIFY(!shm.GetImage(screen->root, 16, 16, layout, &size));
+    QCOMPARE(size, 0U);
+}
+
+void tst_ShmCapture::matchesGetImage_data()
+{
+    QTest::addColumn<int>("width");
+    QTest::addColumn<int>("height");
+    QTest::newRow("small") << 64 << 48;
+    QTest::newRow("odd width") << 101 << 33;
+    // 4MB at 32 bits per pixel, so the segment grows
+    QTest::newRow("past 1MB") << 1024 << 1024;
+    // and a small one after it still fits what's there
+    QTest::newRow("small again") << 50 << 20;
+}
+
+void tst_ShmCapture::matchesGetImage()
+{
+    QFETCH(int, width);
+    QFETCH(int, height);
+    // the same one for every row, so the big one really does grow what the
+    // small ones made
+    ShmCapture *shm = shared;
+    if (!shm->IsAvailable()) QSKIP("no shared memory with this server");
+    xcb_pixmap_t pm = Pixmap(width, height);
+    QByteArray plain = GetImage(pm, width, height);
+    QVERIFY(!plain.isEmpty());
+    uint32_t size = 0;
+    const uchar *data = shm->GetImage(pm, width, height, layout, &size);
+    xcb_free_pixmap(connection, pm);
+    QVERIFY(data);
+    QCOMPARE(size, (uint32_t)plain.size());
+    QCOMPARE((qint64)size, (qint64)layout.Stride(width) * height);
+    QVERIFY(!memcmp(data, plain.constData(), size));
+}
+
+void tst_ShmCapture::badDrawable()
+{
+    ShmCapture shm(connection);
+    if (!shm.IsAvailable()) QSKIP("no shared memory with this server");
+    uint32_t size = 1;
+    QVERIFY(!shm.GetImage(0x1fffffff, 16, 16, layout, &size));
+    QCOMPARE(size, 0U);
+    // nothing there to read is no reason to give up on shm
+    QVERIFY(shm.IsAvailable());
+    xcb_pixmap_t pm = Pixmap(16, 16);
+    QVERIFY(shm.GetImage(pm, 16, 16, layout, &size));
+    xcb_free_pixmap(connection, pm);
+}
+
+void tst_ShmCapture::benchShm()
+{
+    ShmCapture shm(connection);
+    if (!shm.IsAvailable()) QSKIP("no shared memory with this server");
+    xcb_pixmap_t pm = Pixmap(1920, 1080);
+    uint32_t size = 0;
+    QBENCHMARK
+    {
+        shm.GetImage(pm, 1920, 1080, layout, &size);
+    }
+    xcb_free_pixmap(connection, pm);
+    QVERIFY(size);
+}
+
+void tst_ShmCapture::benchGetImage()
+{
+    xcb_pixmap_t pm = Pixmap(1920, 1080);
+    QByteArray plain;
+    QBENCHMARK
+    {
+        plain = GetImage(pm, 1920, 1080);
+    }
+    xcb_free_pixmap(connection, pm);
+    QVERIFY(!plain.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(tst_ShmCapture)
+
+#include "tst_shmcapture.moc"
@@ -0,0 +1,153 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QSharedPointer>
+#include <QWeakPointer>
+#include <QString>
+#include <thread>
+#include "spscring.h"
+
+// SpscRing from one thread and then from two: nothing lost, nothing out of
+// order, however many times the indexes go around.
+class tst_SpscRing : public QObject
+{
+    Q_OBJECT
+private slots:
+    void fillAndEmpty();
+    void wrapsAround();
+    void twoThreads();
+    void twoThreadsOwning();
+    void popLetsGo();
+};
+
+namespace
+{
+    // well past the ring's size so the indexes wrap many times over
+    const quint64 passes = 1000000;
+}
+
+void tst_SpscRing::fillAndEmpty()
+{
+    SpscRing<int, 8> ring;
+    int item = -1;
+    QVERIFY(ring.IsEmpty());
+    QVERIFY(!ring.Pop(item));
+    for (int i = 0; i < 8; ++i) QVERIFY(ring.Push(i));
+    QVERIFY(!ring.IsEmpty());
+    // full, and a failed push leaves it as it was
+    QVERIFY(!ring.Push(100));
+    for (int i = 0; i < 8; ++i)
+    {
+        QVERIFY(ring.Pop(item));
+        QCOMPARE(item, i);
+    }
+    QVERIFY(ring.IsEmpty());
+    QVERIFY(!ring.Pop(item));
+}
+
+void tst_SpscRing::wrapsAround()
+{
+    SpscRing<int, 4096> *ring = new SpscRing<int, 4096>;
+    int next_in = 0, next_out = 0, item;
+    // uneven bursts so the full and empty points land all over the ring
+    for (int burst = 1; next_in < 50000; burst = burst % 4099 + 7)
+    {
+        for (int i = 0; i < burst && ring->Push(next_in); ++i) ++next_in;
+        for (int i = 0; i < burst / 2 && ring->Pop(item); ++i) QCOMPARE(item, next_out++);
+    }
+    while (ring->Pop(item)) QCOMPARE(item, next_out++);
+    QCOMPARE(next_out, next_in);
+    delete ring;
+}
+
+void tst_SpscRing::twoThreads()
+{
+    SpscRing<quint64, 4096> *ring = new SpscRing<quint64, 4096>;
+    std::thread producer([ring]() {
+        for (quint64 i = 0; i < passes; ++i)
+        {
+            while (!ring->Push(i)) std::this_thread::yield();
+        }
+    });
+    quint64 expected = 0, item;
+    bool in_order = true;
+    while (expected < passes)
+    {
+        if (!ring->Pop(item))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        if (item != expected) in_order = false;
+        ++expected;
+    }
+    producer.join();
+    QVERIFY(in_order);
+    QVERIFY(ring->IsEmpty());
+    delete ring;
+}
+
+void tst_SpscRing::twoThreadsOwning()
+{
+    // what the event thread really sends: something with a heap part, which
+    // has to arrive whole
+    SpscRing<QString, 4096> *ring = new SpscRing<QString, 4096>;
+    const int count = 20000;
+    std::thread producer([ring]() {
+        for (int i = 0; i < count; ++i)
+        {
+            QString s = QString::number(i);
+            while (!ring->Push(s)) std::this_thread::yield();
+        }
+    });
+    int expected = 0, bad = 0;
+    QString item;
+    while (expected < count)
+    {
+        if (!ring->Pop(item))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        if (item != QString::number(expected)) ++bad;
+        ++expected;
+    }
+    producer.join();
+    QCOMPARE(bad, 0);
+    delete ring;
+}
+
+void tst_SpscRing::popLetsGo()
+{
+    SpscRing<QSharedPointer<int>, 4> ring;
+    QSharedPointer<int> p(new int(1));
+    QWeakPointer<int> w = p;
+    QVERIFY(ring.Push(p));
+    p.clear();
+    QVERIFY(!w.isNull());
+    QSharedPointer<int> out;
+    QVERIFY(ring.Pop(out));
+    // the slot doesn't keep a copy of its own
+    out.clear();
+    QVERIFY(w.isNull());
+}
+
+QTEST_GUILESS_MAIN(tst_SpscRing)
+
+#include "tst_spscring.moc"
@@ -0,0 +1,128 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QVector>
+#include <xcb/xcb.h>
+#include "stripcapture.h"
+#include "downscaler.h"
+
+Q_DECLARE_METATYPE(PixelConvert::Layout)
+
+// How StripCapture sizes its strips, and a capture of a real pixmap against
+// the same pixmap read in one go and scaled by Downscaler.
+class tst_StripCapture : public QObject
+{
+    Q_OBJECT
+private slots:
+    void rowsPerStrip_data();
+    void rowsPerStrip();
+    void matchesOneShot();
+};
+
+namespace
+{
+    PixelConvert::Layout MakeLayout(uint8_t bpp)
+    {
+        PixelConvert::Layout layout;
+        layout.depth = 24;
+        layout.bits_per_pixel = bpp;
+        layout.scanline_pad = 32;
+        layout.red_mask = 0xff0000;
+        layout.green_mask = 0xff00;
+        layout.blue_mask = 0xff;
+        return layout;
+    }
+}
+
+void tst_StripCapture::rowsPerStrip_data()
+{
+    QTest::addColumn<uint>("max_request_length");
+    QTest::addColumn<PixelConvert::Layout>("layout");
+    QTest::addColumn<int>("width");
+    QTest::addColumn<int>("expected");
+    // without BIG-REQUESTS a request is at most 256KB, less the reply header
+    QTest::newRow("1080p, plain") << 65535U << MakeLayout(32) << 1920 << (65535 * 4 - 32) / (1920 * 4);
+    // with it the strip is capped at 4MB instead
+    QTest::newRow("1080p, big requests") << 4194303U << MakeLayout(32) << 1920 << (4 * 1024 * 1024) / (1920 * 4);
+    QTest::newRow("16 bpp") << 65535U << MakeLayout(16) << 1920 << (65535 * 4 - 32) / (1920 * 2);
+    // a row that doesn't fit still gets read one at a time
+    QTest::newRow("too wide") << 65535U << MakeLayout(32) << 100000 << 1;
+    QTest::newRow("no layout") << 65535U << PixelConvert::Layout() << 1920 << 0;
+}
+
+void tst_StripCapture::rowsPerStrip()
+{
+    QFETCH(uint, max_request_length);
+    QFETCH(PixelConvert::Layout, layout);
+    QFETCH(int, width);
+    QFETCH(int, expected);
+    QCOMPARE(StripCapture::RowsPerStrip(max_request_length, layout, width), expected);
+}
+
+void tst_StripCapture::matchesOneShot()
+{
+    xcb_connection_t *c = xcb_connect(nullptr, nullptr);
+    QVERIFY(!xcb_connection_has_error(c));
+    xcb_screen_t *screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+    PixelConvert::Layout layout = PixelConvert::Describe(c, screen->root_visual, screen->root_depth);
+    QVERIFY(layout.IsValid());
+    // tall enough to take several strips even with big requests
+    const uint16_t width = 640;
+    const uint16_t height = qMin(4000, StripCapture::RowsPerStrip(c, layout, width) * 3 + 17);
+    xcb_pixmap_t pm = xcb_generate_id(c);
+    xcb_create_pixmap(c, screen->root_depth, pm, screen->root, width, height);
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    uint32_t color = 0;
+    xcb_create_gc(c, gc, pm, XCB_GC_FOREGROUND, &color);
+    // bands of color that don't line up with the strips or the blocks
+    for (int y = 0; y < height; y += 13)
+    {
+        color = (y * 0x010307) & 0xffffff;
+        xcb_change_gc(c, gc, XCB_GC_FOREGROUND, &color);
+        xcb_rectangle_t band = {0, (int16_t)y, width, 13};
+        xcb_poly_fill_rectangle(c, pm, gc, 1, &band);
+        color ^= 0xffffff;
+        xcb_change_gc(c, gc, XCB_GC_FOREGROUND, &color);
+        xcb_rectangle_t spot = {(int16_t)(y % width), (int16_t)y, 37, 13};
+        xcb_poly_fill_rectangle(c, pm, gc, 1, &spot);
+    }
+    const QSize size(64, 64 * height / width);
+    QImage strips = StripCapture::Capture(c, pm, screen->root_visual, screen->root_depth, QSize(width, height), size);
+    // the same pixels read a row band at a time the plain way
+    QImage whole(width, height, QImage::Format_RGB32);
+    int band_rows = StripCapture::RowsPerStrip(c, layout, width);
+    for (int y = 0; y < height; y += band_rows)
+    {
+        int rows = qMin(band_rows, height - y);
+        xcb_get_image_reply_t *reply = xcb_get_image_reply(c, xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, pm, 0, y, width, rows, ~0U), nullptr);
+        QVERIFY(reply);
+        QImage part = PixelConvert::ToImage(xcb_get_image_data(reply), xcb_get_image_data_length(reply), width, rows, layout);
+        for (int r = 0; r < rows; ++r) memcpy(whole.scanLine(y + r), part.constScanLine(r), width * 4);
+        free(reply);
+    }
+    xcb_free_gc(c, gc);
+    xcb_free_pixmap(c, pm);
+    xcb_disconnect(c);
+    QCOMPARE(strips.size(), size);
+    QCOMPARE(strips, Downscaler::Scale(whole, size));
+}
+
+QTEST_GUILESS_MAIN(tst_StripCapture)
+
+#include "tst_stripcapture.moc"
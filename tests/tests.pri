@@ -0,0 +1,31 @@
+# Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+# This file is part of WMIIB2.
+
+# WMIIB2 is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+
+# WMIIB2 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+
+# You should have received a copy of the GNU General Public License
+# along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+
+# What every test shares: Qt's test library, the application's headers and
+# the same X libraries the application links.
+
+QT       += core gui x11extras testlib
+
+TEMPLATE = app
+CONFIG += console testcase
+CONFIG -= app_bundle
+LIBS += -lxcb -lxcb-composite -lxcb-damage -lxcb-shm -lxcb-render
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += $$PWD/..
+DEPENDPATH += $$PWD/..
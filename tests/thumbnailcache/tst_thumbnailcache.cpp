@@ -0,0 +1,103 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QPixmap>
+#include "thumbnailcache.h"
+
+class tst_ThumbnailCache : public QObject
+{
+    Q_OBJECT
+private slots:
+    void hitAndMiss();
+    void smallerFromBigger();
+    void newContentReplacesOld();
+    void remove();
+    void evictsOverBudget();
+};
+
+namespace
+{
+    QPixmap Icon(int size)
+    {
+        QPixmap pm(size, size);
+        pm.fill(Qt::red);
+        return pm;
+    }
+}
+
+void tst_ThumbnailCache::hitAndMiss()
+{
+    ThumbnailCache cache(1024 * 1024);
+    cache.Insert(1, 0, 5, 64, Icon(64));
+    QCOMPARE(cache.Find(1, 0, 5, 64).size(), QSize(64, 64));
+    // another generation, other contents or another window are all misses
+    QVERIFY(cache.Find(1, 1, 5, 64).isNull());
+    QVERIFY(cache.Find(1, 0, 6, 64).isNull());
+    QVERIFY(cache.Find(2, 0, 5, 64).isNull());
+    QCOMPARE(cache.Hits(), (quint64)1);
+    QCOMPARE(cache.Misses(), (quint64)3);
+}
+
+void tst_ThumbnailCache::smallerFromBigger()
+{
+    ThumbnailCache cache(1024 * 1024);
+    cache.Insert(1, 0, 5, 128, Icon(128));
+    QCOMPARE(cache.Find(1, 0, 5, 32).size(), QSize(32, 32));
+    // and that one is kept now
+    QCOMPARE(cache.Find(1, 0, 5, 32).size(), QSize(32, 32));
+    QCOMPARE(cache.Misses(), (quint64)0);
+    // nothing gets blown up from a smaller one
+    QVERIFY(cache.Find(1, 0, 5, 256).isNull());
+}
+
+void tst_ThumbnailCache::newContentReplacesOld()
+{
+    ThumbnailCache cache(1024 * 1024);
+    cache.Insert(1, 0, 5, 64, Icon(64));
+    cache.Insert(1, 0, 6, 64, Icon(64));
+    QVERIFY(cache.Find(1, 0, 5, 64).isNull());
+    QVERIFY(!cache.Find(1, 0, 6, 64).isNull());
+}
+
+void tst_ThumbnailCache::remove()
+{
+    ThumbnailCache cache(1024 * 1024);
+    cache.Insert(1, 0, 5, 64, Icon(64));
+    cache.Insert(1, 0, 5, 32, Icon(32));
+    cache.Insert(2, 0, 5, 64, Icon(64));
+    cache.Remove(1);
+    QVERIFY(cache.Find(1, 0, 5, 64).isNull());
+    QVERIFY(cache.Find(1, 0, 5, 32).isNull());
+    QVERIFY(!cache.Find(2, 0, 5, 64).isNull());
+}
+
+void tst_ThumbnailCache::evictsOverBudget()
+{
+    // only room for one 64x64 icon whatever depth the pixmaps end up
+    ThumbnailCache cache(20 * 1024);
+    for (xcb_window_t win = 1; win <= 4; ++win) cache.Insert(win, 0, 0, 64, Icon(64));
+    QVERIFY(cache.Evictions() >= 2);
+    // the newest is still there, the oldest isn't
+    QVERIFY(!cache.Find(4, 0, 0, 64).isNull());
+    QVERIFY(cache.Find(1, 0, 0, 64).isNull());
+}
+
+QTEST_MAIN(tst_ThumbnailCache)
+
+#include "tst_thumbnailcache.moc"
@@ -0,0 +1,177 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QSharedPointer>
+#include <QWeakPointer>
+#include "windowregistry.h"
+
+// WindowRegistry has no X in it at all: slots of removed windows get reused,
+// a window that comes back under the same id is told apart by its
+// generation, and growing the array mustn't lose anyone.
+class tst_WindowRegistry : public QObject
+{
+    Q_OBJECT
+private slots:
+    void insertFind();
+    void reusesSlots();
+    void generations();
+    void growing();
+    void forEachSkipsFree();
+    void removeLetsGo();
+};
+
+namespace
+{
+    struct value
+    {
+        value() : n(0) { }
+        int n;
+        QSharedPointer<int> held;
+    };
+}
+
+void tst_WindowRegistry::insertFind()
+{
+    WindowRegistry<value> reg;
+    QVERIFY(!reg.Find(1));
+    QCOMPARE(reg.Generation(1), 0U);
+    reg.Insert(1).n = 10;
+    reg.Insert(2).n = 20;
+    QCOMPARE(reg.Count(), 2);
+    QVERIFY(reg.Contains(1));
+    QCOMPARE(reg.Find(1)->n, 10);
+    QCOMPARE(reg.Find(2)->n, 20);
+    const WindowRegistry<value> &creg = reg;
+    QCOMPARE(creg.Find(2)->n, 20);
+    // inserting again starts it over
+    reg.Insert(1);
+    QCOMPARE(reg.Find(1)->n, 0);
+    QCOMPARE(reg.Count(), 2);
+    QVERIFY(!reg.Remove(3));
+}
+
+void tst_WindowRegistry::reusesSlots()
+{
+    WindowRegistry<value> reg;
+    for (xcb_window_t w = 1; w <= 4; ++w) reg.Insert(w).n = w;
+    value *second = reg.Find(2);
+    QVERIFY(reg.Remove(2));
+    QVERIFY(!reg.Find(2));
+    QCOMPARE(reg.Count(), 3);
+    // the next window goes where the removed one was, nothing moves
+    value *fifth = &reg.Insert(5);
+    QCOMPARE(fifth, second);
+    QCOMPARE(reg.Find(1)->n, 1);
+    QCOMPARE(reg.Find(3)->n, 3);
+    QCOMPARE(reg.Find(4)->n, 4);
+    // the last slot freed is the first reused
+    value *first = reg.Find(1), *third = reg.Find(3);
+    reg.Remove(1);
+    reg.Remove(3);
+    QCOMPARE(&reg.Insert(6), third);
+    QCOMPARE(&reg.Insert(7), first);
+}
+
+void tst_WindowRegistry::generations()
+{
+    WindowRegistry<value> reg;
+    reg.Insert(1);
+    quint32 g1 = reg.Generation(1);
+    QVERIFY(g1);
+    QVERIFY(reg.Find(1, g1));
+    reg.Remove(1);
+    QCOMPARE(reg.Generation(1), 0U);
+    QVERIFY(!reg.Find(1, g1));
+    // same id, same slot, but somebody else
+    reg.Insert(1);
+    quint32 g2 = reg.Generation(1);
+    QVERIFY(g2 != g1);
+    QVERIFY(!reg.Find(1, g1));
+    QVERIFY(reg.Find(1, g2));
+    // replacing without a remove is a new window too
+    reg.Insert(1);
+    QVERIFY(!reg.Find(1, g2));
+    QVERIFY(reg.Find(1, reg.Generation(1)));
+    // and generation 0 never matches
+    QVERIFY(!reg.Find(1, 0));
+    QVERIFY(!reg.Find(2, 0));
+}
+
+void tst_WindowRegistry::growing()
+{
+    WindowRegistry<value> reg;
+    QVector<quint32> gens;
+    // plenty of reallocations on the way
+    for (xcb_window_t w = 0; w < 5000; ++w)
+    {
+        reg.Insert(0x400000 + w).n = w;
+        gens << reg.Generation(0x400000 + w);
+    }
+    QCOMPARE(reg.Count(), 5000);
+    for (xcb_window_t w = 0; w < 5000; ++w)
+    {
+        value *v = reg.Find(0x400000 + w, gens.at(w));
+        QVERIFY(v);
+        QCOMPARE(v->n, (int)w);
+    }
+    // every other one gone and back again, still pointing at the right slots
+    for (xcb_window_t w = 0; w < 5000; w += 2) reg.Remove(0x400000 + w);
+    for (xcb_window_t w = 0; w < 6000; w += 2) reg.Insert(0x800000 + w).n = -(int)w;
+    for (xcb_window_t w = 1; w < 5000; w += 2) QCOMPARE(reg.Find(0x400000 + w, gens.at(w))->n, (int)w);
+    for (xcb_window_t w = 0; w < 6000; w += 2) QCOMPARE(reg.Find(0x800000 + w)->n, -(int)w);
+    QCOMPARE(reg.Count(), 2500 + 3000);
+}
+
+void tst_WindowRegistry::forEachSkipsFree()
+{
+    WindowRegistry<value> reg;
+    for (xcb_window_t w = 1; w <= 6; ++w) reg.Insert(w).n = w;
+    reg.Remove(2);
+    reg.Remove(5);
+    QList<xcb_window_t> seen;
+    int sum = 0;
+    reg.ForEach([&seen, &sum](xcb_window_t win, value &v) {
+        seen << win;
+        sum += v.n;
+        v.n *= 10;
+    });
+    // storage order, which is insert order here
+    QCOMPARE(seen, QList<xcb_window_t>() << 1 << 3 << 4 << 6);
+    QCOMPARE(sum, 1 + 3 + 4 + 6);
+    QCOMPARE(reg.Find(4)->n, 40);
+    seen.clear();
+    const WindowRegistry<value> &creg = reg;
+    creg.ForEach([&seen](xcb_window_t win, const value &) { seen << win; });
+    QCOMPARE(seen, QList<xcb_window_t>() << 1 << 3 << 4 << 6);
+}
+
+void tst_WindowRegistry::removeLetsGo()
+{
+    WindowRegistry<value> reg;
+    reg.Insert(1).held = QSharedPointer<int>(new int(1));
+    QWeakPointer<int> held = reg.Find(1)->held;
+    QVERIFY(!held.isNull());
+    // right away, not when the slot happens to be reused
+    reg.Remove(1);
+    QVERIFY(held.isNull());
+}
+
+QTEST_GUILESS_MAIN(tst_WindowRegistry)
+
+#include "tst_windowregistry.moc"
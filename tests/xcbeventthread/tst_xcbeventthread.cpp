@@ -0,0 +1,108 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <QSignalSpy>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <functional>
+#include <atomic>
+#include <xcb/xcb.h>
+#include "xcbeventthread.h"
+#include "ewmhatoms.h"
+
+// XcbEventThread hands what its filter sees over to the gui thread in order,
+// and a gui thread that has stopped draining mustn't keep it from shutting
+// down once the event thread is stuck waiting for room.
+class tst_XcbEventThread : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void deliversInOrder();
+    void stopsWhileFull();
+
+private:
+    // runs fn on evthread's own thread, the way its filter would call it
+    static void OnEventThread(XcbEventThread *evthread, const std::function<void()> &fn);
+};
+
+void tst_XcbEventThread::initTestCase()
+{
+    qRegisterMetaType<xcb_window_t>("xcb_window_t");
+    EwmhAtoms::Resolve();
+}
+
+void tst_XcbEventThread::OnEventThread(XcbEventThread *evthread, const std::function<void()> &fn)
+{
+    QThread *thread = evthread->findChild<QThread *>();
+    QVERIFY(thread);
+    QObject *helper = new QObject;
+    helper->moveToThread(thread);
+    QTimer::singleShot(0, helper, [helper, fn]() {
+        fn();
+        delete helper;
+    });
+}
+
+void tst_XcbEventThread::deliversInOrder()
+{
+    XcbEventThread evthread;
+    QVERIFY(evthread.IsValid());
+    evthread.Start();
+    QSignalSpy damaged(&evthread, SIGNAL(WindowDamaged(xcb_window_t)));
+    const int count = 10000;
+    // more than the ring holds, so the event thread has to wait on us a few times
+    OnEventThread(&evthread, [&evthread]() {
+        for (int i = 1; i <= count; ++i) QMetaObject::invokeMethod(&evthread, "QueueDamaged", Qt::DirectConnection, Q_ARG(xcb_window_t, i));
+    });
+    QTRY_COMPARE_WITH_TIMEOUT(damaged.count(), count, 10000);
+    for (int i = 0; i < count; ++i) QCOMPARE(damaged.at(i).at(0).value<xcb_window_t>(), (xcb_window_t)(i + 1));
+}
+
+void tst_XcbEventThread::stopsWhileFull()
+{
+    XcbEventThread *evthread = new XcbEventThread;
+    QVERIFY(evthread->IsValid());
+    evthread->Start();
+    std::atomic<int> queued(0);
+    OnEventThread(evthread, [evthread, &queued]() {
+        for (int i = 1; i <= 5000; ++i)
+        {
+            QMetaObject::invokeMethod(evthread, "QueueDamaged", Qt::DirectConnection, Q_ARG(xcb_window_t, i));
+            ++queued;
+        }
+    });
+    // no event loop here, so nothing drains and it gets stuck one past full
+    QElapsedTimer timer;
+    timer.start();
+    while (queued.load() < 4096 && timer.elapsed() < 5000) QThread::msleep(10);
+    QCOMPARE(queued.load(), 4096);
+    QThread::msleep(200);
+    QCOMPARE(queued.load(), 4096);
+    // and shutting down gets it unstuck well before anyone would notice
+    timer.restart();
+    delete evthread;
+    QVERIFY(timer.elapsed() < 1000);
+    QCOMPARE(queued.load(), 5000);
+}
+
+QTEST_GUILESS_MAIN(tst_XcbEventThread)
+
+#include "tst_xcbeventthread.moc"
@@ -0,0 +1,111 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QtTest>
+#include <xcb/xcb.h>
+#include <cstring>
+#include "xcbreplyqueue.h"
+
+// Continuations have to run in the order their requests went out, and on a
+// connection someone else reads (as Qt's is) an event has to be enough to
+// pick up a reply that never woke the socket notifier.
+class tst_XcbReplyQueue : public QObject
+{
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void inOrder();
+    void pollsOnEvent();
+
+private:
+    // reads everything outstanding into xcb's own queues, the way Qt's
+    // reader thread would, without handing any of it out
+    void Drain();
+    xcb_connection_t *connection;
+};
+
+void tst_XcbReplyQueue::initTestCase()
+{
+    connection = xcb_connect(nullptr, nullptr);
+    QVERIFY(!xcb_connection_has_error(connection));
+}
+
+void tst_XcbReplyQueue::cleanupTestCase()
+{
+    xcb_disconnect(connection);
+}
+
+void tst_XcbReplyQueue::Drain()
+{
+    free(xcb_get_input_focus_reply(connection, xcb_get_input_focus(connection), nullptr));
+}
+
+void tst_XcbReplyQueue::inOrder()
+{
+    XcbReplyQueue replies(connection);
+    QList<int> ran;
+    xcb_get_input_focus_cookie_t cookie = xcb_get_input_focus(connection);
+    replies.Expect(cookie.sequence, [&ran](void *reply, xcb_generic_error_t *err) {
+        QVERIFY(reply);
+        QVERIFY(!err);
+        free(reply);
+        ran << 1;
+    });
+    // a bad window gets an error instead
+    xcb_get_geometry_cookie_t bad = xcb_get_geometry(connection, 0x1fffffff);
+    replies.Expect(bad.sequence, [&ran](void *reply, xcb_generic_error_t *err) {
+        QVERIFY(!reply);
+        QVERIFY(err);
+        free(err);
+        ran << 2;
+    });
+    replies.AfterPending([&ran]() { ran << 3; });
+    QCOMPARE(replies.Pending(), 3);
+    QTRY_COMPARE_WITH_TIMEOUT(ran.count(), 3, 2000);
+    QCOMPARE(ran, QList<int>() << 1 << 2 << 3);
+    QCOMPARE(replies.Pending(), 0);
+}
+
+void tst_XcbReplyQueue::pollsOnEvent()
+{
+    XcbReplyQueue replies(connection);
+    bool ran = false;
+    replies.AfterPending([&ran]() { ran = true; });
+    // the reply is in, but nothing on the socket is left to say so
+    Drain();
+    QVERIFY(!ran);
+    // what Qt does with every event it reads
+    xcb_generic_event_t ev;
+    memset(&ev, 0, sizeof(ev));
+    QVERIFY(!replies.nativeEventFilter("xcb_generic_event_t", &ev, nullptr));
+    QVERIFY(ran);
+    QCOMPARE(replies.Pending(), 0);
+    // other kinds of native events are none of its business
+    ran = false;
+    replies.AfterPending([&ran]() { ran = true; });
+    Drain();
+    replies.nativeEventFilter("windows_generic_MSG", &ev, nullptr);
+    QVERIFY(!ran);
+    replies.Poll();
+    QVERIFY(ran);
+}
+
+QTEST_GUILESS_MAIN(tst_XcbReplyQueue)
+
+#include "tst_xcbreplyqueue.moc"
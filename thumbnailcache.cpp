@@ -0,0 +1,141 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "thumbnailcache.h"
+#include "downscaler.h"
+#include "logcategories.h"
+#include <climits>
+
+uint qHash(const ThumbnailCache::key &k, uint seed)
+{
+    return qHash(k.win, seed) ^ qHash(k.generation * 31U + k.content, seed) ^ (uint)k.size;
+}
+
+ThumbnailCache::ThumbnailCache(qint64 max_bytes) :
+    hits(0), misses(0), evictions(0)
+{
+    SetMaxBytes(max_bytes);
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    qCDebug(lcStats) << "ThumbnailCache: hits" << hits << "misses" << misses << "evictions" << evictions;
+}
+
+void ThumbnailCache::SetMaxBytes(qint64 max_bytes)
+{
+    int max_kb = (int)qBound((qint64)1, max_bytes / 1024, (qint64)INT_MAX);
+    if (max_kb == cache.maxCost()) return;
+    int before = cache.count();
+    cache.setMaxCost(max_kb);
+    if (cache.count() < before)
+    {
+        evictions += before - cache.count();
+        // sort out which ones went
+        QList<key> gone;
+        for (QHash<xcb_window_t, QList<key> >::const_iterator it = by_window.cbegin(); it != by_window.cend(); ++it)
+        {
+            for (int i = 0; i < it.value().count(); ++i)
+            {
+                if (!cache.contains(it.value().at(i))) gone.append(it.value().at(i));
+            }
+        }
+        for (int i = 0; i < gone.count(); ++i) Forget(gone.at(i));
+    }
+}
+
+QPixmap ThumbnailCache::Find(xcb_window_t win, quint32 generation, quint32 content, int size)
+{
+    key k = {win, generation, content, size};
+    if (QPixmap *pm = cache.object(k))
+    {
+        ++hits;
+        return *pm;
+    }
+    // take the smallest one we have that's still bigger and shrink it
+    key best = k;
+    best.size = 0;
+    QList<key> stale;
+    const QList<key> keys = by_window.value(win);
+    for (int i = 0; i < keys.count(); ++i)
+    {
+        const key &other = keys.at(i);
+        if (!cache.contains(other)) stale.append(other);
+        else if (other.generation == generation && other.content == content && other.size > size && (!best.size || other.size < best.size)) best = other;
+    }
+    for (int i = 0; i < stale.count(); ++i) Forget(stale.at(i));
+    if (best.size)
+    {
+        QPixmap *pm = cache.object(best);
+        QImage img = Downscaler::Scale(pm->toImage(), size);
+        if (!img.isNull())
+        {
+            ++hits;
+            QPixmap ret = QPixmap::fromImage(img);
+            Insert(win, generation, content, size, ret);
+            return ret;
+        }
+    }
+    ++misses;
+    return QPixmap();
+}
+
+void ThumbnailCache::Insert(xcb_window_t win, quint32 generation, quint32 content, int size, const QPixmap &pm)
+{
+    if (pm.isNull()) return;
+    key k = {win, generation, content, size};
+    // each window only ever has one version of its contents worth keeping,
+    // and this is a good time to forget whatever QCache dropped on its own
+    QList<key> old;
+    const QList<key> keys = by_window.value(win);
+    for (int i = 0; i < keys.count(); ++i)
+    {
+        if (keys.at(i).generation != generation || keys.at(i).content != content || !cache.contains(keys.at(i))) old.append(keys.at(i));
+    }
+    for (int i = 0; i < old.count(); ++i) Forget(old.at(i));
+    bool replacing = cache.contains(k);
+    int cost = qMax(1, (int)(((qint64)pm.width() * pm.height() * pm.depth() / 8 + 1023) / 1024));
+    int before = cache.count() - (replacing ? 1 : 0);
+    // insert() throws out whatever it has to, and the new one too if it's
+    // bigger than the whole budget
+    if (cache.insert(k, new QPixmap(pm), cost))
+    {
+        if (!replacing) by_window[win].append(k);
+        if (cache.count() - 1 < before) evictions += before - (cache.count() - 1);
+    }
+    else
+    {
+        if (replacing) Forget(k);
+        ++evictions;
+    }
+}
+
+void ThumbnailCache::Remove(xcb_window_t win)
+{
+    const QList<key> keys = by_window.take(win);
+    for (int i = 0; i < keys.count(); ++i) cache.remove(keys.at(i));
+}
+
+void ThumbnailCache::Forget(const key &k)
+{
+    cache.remove(k);
+    QHash<xcb_window_t, QList<key> >::iterator it = by_window.find(k.win);
+    if (it == by_window.end()) return;
+    it.value().removeAll(k);
+    if (it.value().isEmpty()) by_window.erase(it);
+}
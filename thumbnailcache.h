@@ -0,0 +1,70 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QCache>
+#include <QPixmap>
+#include <QHash>
+#include <QList>
+#include <xcb/xcb.h>
+
+// Finished icons, so relayouts and icon size changes don't have to go back
+// to the X server.  An entry is only good for one window (and registry
+// generation, since ids get reused), one version of its contents and one
+// size.  Least recently used entries go first once the byte budget is used.
+class ThumbnailCache
+{
+public:
+    explicit ThumbnailCache(qint64 max_bytes);
+    ~ThumbnailCache();
+    void SetMaxBytes(qint64 max_bytes);
+    // null if it isn't in there.  a miss on a size that was never asked for
+    // is still served from a bigger icon of the same contents if there is one.
+    QPixmap Find(xcb_window_t win, quint32 generation, quint32 content, int size);
+    void Insert(xcb_window_t win, quint32 generation, quint32 content, int size, const QPixmap &pm);
+    // drops everything for the window, for when it's gone or changed
+    void Remove(xcb_window_t win);
+    quint64 Hits() const { return hits; }
+    quint64 Misses() const { return misses; }
+    quint64 Evictions() const { return evictions; }
+
+private:
+    struct key
+    {
+        xcb_window_t win;
+        quint32 generation;
+        quint32 content;
+        int size;
+        bool operator==(const key &other) const
+        {
+            return win == other.win && generation == other.generation && content == other.content && size == other.size;
+        }
+    };
+    friend uint qHash(const key &k, uint seed);
+    // QCache counts cost in ints, so the budget is kept in KiB
+    QCache<key, QPixmap> cache;
+    // which sizes each window has in there, so Remove() and the fallback in
+    // Find() don't have to walk the whole cache
+    QHash<xcb_window_t, QList<key> > by_window;
+    quint64 hits, misses, evictions;
+    void Forget(const key &k);
+};
+
+#endif // THUMBNAILCACHE_H
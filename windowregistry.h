@@ -0,0 +1,137 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef WINDOWREGISTRY_H
+#define WINDOWREGISTRY_H
+
+#include <QHash>
+#include <QVector>
+#include <xcb/xcb.h>
+
+// Per-window state kept as plain structs in one contiguous array, with a
+// single hash from window id to slot.  Slots of removed windows are reused,
+// and every insert gets a fresh generation number, so something that has to
+// look a window up again later (a reply handler, say) can tell whether it's
+// still the same window or a new one that happens to have the same id.
+//
+// Pointers from Find()/Insert() are only good until the next Insert().
+template <typename T>
+class WindowRegistry
+{
+public:
+    WindowRegistry() : next_generation(1) { }
+
+    T *Find(xcb_window_t win)
+    {
+        int i = index.value(win, -1);
+        return (i < 0) ? nullptr : &entries[i].value;
+    }
+    const T *Find(xcb_window_t win) const
+    {
+        int i = index.value(win, -1);
+        return (i < 0) ? nullptr : &entries.at(i).value;
+    }
+    // only finds it if it's the same one that had that generation
+    T *Find(xcb_window_t win, quint32 generation)
+    {
+        int i = index.value(win, -1);
+        return (i < 0 || entries.at(i).generation != generation) ? nullptr : &entries[i].value;
+    }
+    bool Contains(xcb_window_t win) const { return index.contains(win); }
+    // 0 if there's no such window
+    quint32 Generation(xcb_window_t win) const
+    {
+        int i = index.value(win, -1);
+        return (i < 0) ? 0 : entries.at(i).generation;
+    }
+    int Count() const { return index.count(); }
+
+    // a freshly default constructed entry; replaces any that was there
+    T &Insert(xcb_window_t win)
+    {
+        int i = index.value(win, -1);
+        if (i < 0)
+        {
+            if (free_slots.isEmpty())
+            {
+                i = entries.count();
+                entries.append(entry());
+            }
+            else
+            {
+                i = free_slots.last();
+                free_slots.removeLast();
+            }
+            index.insert(win, i);
+        }
+        entry &e = entries[i];
+        e.window = win;
+        e.generation = next_generation++;
+        // generation 0 means "none"
+        if (!next_generation) next_generation = 1;
+        e.value = T();
+        return e.value;
+    }
+
+    bool Remove(xcb_window_t win)
+    {
+        int i = index.value(win, -1);
+        if (i < 0) return false;
+        index.remove(win);
+        entry &e = entries[i];
+        e.window = 0;
+        e.generation = 0;
+        // let go of anything the entry owned now rather than on reuse
+        e.value = T();
+        free_slots.append(i);
+        return true;
+    }
+
+    // fn(xcb_window_t, T &) for every window, in storage order
+    template <typename F>
+    void ForEach(F fn)
+    {
+        for (entry &e : entries)
+        {
+            if (e.generation) fn(e.window, e.value);
+        }
+    }
+    template <typename F>
+    void ForEach(F fn) const
+    {
+        for (const entry &e : entries)
+        {
+            if (e.generation) fn(e.window, e.value);
+        }
+    }
+
+private:
+    struct entry
+    {
+        entry() : window(0), generation(0) { }
+        xcb_window_t window;
+        quint32 generation;
+        T value;
+    };
+    QVector<entry> entries;
+    QVector<int> free_slots;
+    QHash<xcb_window_t, int> index;
+    quint32 next_generation;
+};
+
+#endif // WINDOWREGISTRY_H
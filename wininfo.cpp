@@ -21,104 +21,123 @@ along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
 #include <xcb/composite.h>
 #include <QDebug>
 #include "xcbeventfilter.h"
-#include "atomcache.h"
+#include "shmcapture.h"
+#include "downscaler.h"
+#include "renderscaler.h"
+#include "capturecontext.h"
+#include "pixelconvert.h"
+#include "stripcapture.h"
+#include "netwmicon.h"
+#include "iconstore.h"
+#include "logcategories.h"
 
-WinInfo::WinInfo(xcb_window_t win_id, const QString &title, QObject *parent) :
-    QObject(parent), xcb_win(win_id), win_title(title)
+WinInfo::WinInfo() :
+    connection(nullptr), xcb_win(0UL), xcb_vis(0UL), win_width(0), win_height(0),
+    win_depth(0), wm_icons_fetched(false), icons_serial(0)
 {
+}
+
+WinInfo::WinInfo(xcb_window_t win_id, const QString &title) :
+    xcb_win(win_id), xcb_vis(0UL), win_width(0), win_height(0), win_depth(0), win_title(title), wm_icons_fetched(false), icons_serial(0)
+{
+    // nothing to show until the first CollectPixmap()
     connection = QX11Info::connection();
-    xcb_generic_error_t *err = nullptr;
-    xcb_get_geometry_cookie_t gg_cookie = xcb_get_geometry(connection, win_id);
-    xcb_get_geometry_reply_t *gg_reply = xcb_get_geometry_reply(connection, gg_cookie, &err);
-    if (gg_reply)
-    {
-        win_width = gg_reply->width;
-        win_height = gg_reply->height;
-        win_depth = gg_reply->depth;
-        free(gg_reply);
-    }
-    xcbEventFilter::errorHandler("WinInfo::WinInfo: get_geometry: ", &err);
-    xcb_pm = xcb_generate_id(connection);
-    pm_alloced = false;
-    UpdatePixmap();
 }
 
-WinInfo::~WinInfo()
+WinInfo::NamedPixmap::~NamedPixmap()
+{
+    xcb_free_pixmap(connection, id);
+    // this may be a worker letting go, with nobody about to flush after it
+    xcb_flush(connection);
+}
+
+void WinInfo::IconChanged()
+{
+    wm_icons.reset();
+    wm_icons_fetched = false;
+    ++icons_serial;
+}
+
+void WinInfo::Release()
+{
+    pixmap.reset();
+}
+
+QImage WinInfo::CaptureIcon(CaptureContext &ctx, int icon_size, IconFetch *fetch) const
+{
+    fetch->icons = wm_icons;
+    fetch->fetched = wm_icons_fetched;
+    fetch->serial = icons_serial;
+    fetch->from_contents = false;
+    return MakeIcon(ctx, icon_size, *fetch);
+}
+
+void WinInfo::KeepIcons(const IconFetch &fetch)
 {
-    xcb_free_pixmap(connection, xcb_pm);
+    if (wm_icons_fetched || !fetch.fetched || fetch.serial != icons_serial) return;
+    wm_icons = fetch.icons;
+    wm_icons_fetched = true;
 }
 
-QPixmap WinInfo::GetPixmap(bool updatenwp)
+QImage WinInfo::MakeIcon(CaptureContext &ctx, int icon_size, IconFetch &fetch) const
 {
-    static xcb_atom_t net_wm_icon = AtomCache::GetAtom("_NET_WM_ICON");
-    QPixmap ret;
-    // ask compositor to associate window with pixmap
-    if (updatenwp || !pm_alloced) UpdatePixmap();
-    if (pm_alloced)
+    // scale while it's still a plain raster image so the only thing that ever
+    // becomes a pixmap is the icon itself.  the capture may still be sitting
+    // in the shm segment, which is fine since we're done with it right here.
+    if (pixmap && !ctx.Shm()->IsAvailable())
     {
-        // now get the image
-        xcb_generic_error_t *err = nullptr;
-        xcb_get_image_cookie_t gi_cookie = xcb_get_image(connection, XCB_IMAGE_FORMAT_Z_PIXMAP, xcb_pm, 0, 0, win_width, win_height, (uint32_t)(~0UL));
-        xcb_get_image_reply_t *gi_reply = xcb_get_image_reply(connection, gi_cookie, &err);
-        if (gi_reply)
+        // no shared memory usually means the server is across a network, so
+        // have it shrink the window before anything gets sent
+        QSize dst = QSize(win_width, win_height).scaled(icon_size, icon_size, Qt::KeepAspectRatio);
+        QImage small = ctx.Render()->Scale(pixmap->id, xcb_vis, win_width, win_height, dst);
+        if (!small.isNull())
         {
-            int data_len = xcb_get_image_data_length(gi_reply);
-            uint8_t *data = xcb_get_image_data(gi_reply);
-            uchar *imgdat = (uchar*)malloc(data_len);
-            if (imgdat)
-            {
-                memcpy(imgdat, data, data_len);
-                QImage img(imgdat, win_width, win_height, QImage::Format_RGB32, free, imgdat);
-                ret = QPixmap::fromImage(img);
-            }
-            else qDebug() << "WinInfo::GetPixmap: malloc failed for imgdat";
-            free(gi_reply);
+            fetch.from_contents = true;
+            return Downscaler::Scale(small, icon_size);
         }
-        xcbEventFilter::errorHandler("WinInfo::GetPixmap: get_image: ", &err);
     }
+    QImage img = CaptureImage(ctx, icon_size, fetch);
+    // the default icon and some window icons come at the right size already
+    if (qMax(img.width(), img.height()) != icon_size) img = Downscaler::Scale(img, icon_size);
+    return img;
+}
+
+QImage WinInfo::CaptureImage(CaptureContext &ctx, int icon_size, IconFetch &fetch) const
+{
+    xcb_connection_t *c = ctx.Connection();
+    QImage ret;
+    if (pixmap)
+    {
+        // try shared memory first, it saves pushing the whole image through the socket
+        ShmCapture *shm = ctx.Shm();
+        uint32_t shm_len = 0;
+        PixelConvert::Layout layout = PixelConvert::Describe(c, xcb_vis, win_depth);
+        const uchar *shm_data = shm->IsAvailable() ? shm->GetImage(pixmap->id, win_width, win_height, layout, &shm_len) : nullptr;
+        if (shm_data) ret = PixelConvert::ToImage(shm_data, shm_len, win_width, win_height, layout);
+    }
+    if (pixmap && ret.isNull())
+    {
+        // an icon never needs the whole frame here, so it's read a strip at a
+        // time and scaled on the way in
+        QSize src_size(win_width, win_height);
+        QSize size = icon_size > 0 ? src_size.scaled(icon_size, icon_size, Qt::KeepAspectRatio).boundedTo(src_size) : src_size;
+        ret = StripCapture::Capture(c, pixmap->id, xcb_vis, win_depth, src_size, size);
+    }
+    fetch.from_contents = !ret.isNull();
     // fall back to window icon
     if (ret.isNull())
     {
-        xcb_get_property_cookie_t prop_cookie = xcb_get_property(connection, 0, xcb_win, net_wm_icon, XCB_ATOM_CARDINAL, 0, 262144UL);
-        xcb_get_property_reply_t *prop_reply;
-        xcb_generic_error_t *err = nullptr;
-        if ((prop_reply = xcb_get_property_reply(connection, prop_cookie, &err)))
+        // parsed once and kept until the property changes
+        if (!fetch.fetched)
         {
-            uint32_t data_len = prop_reply->value_len;
-            uint8_t data_fmt = prop_reply->format;
-            uint32_t icon_width = 0UL;
-            uint32_t icon_height = 0UL;
-            // we're going to just use the first icon
-            if (data_fmt == 32 && data_len >= 8)
-            {
-                uint32_t *data = (uint32_t *)xcb_get_property_value(prop_reply);
-                icon_width = data[0];
-                icon_height = data[1];
-                uint32_t imgdat_size = icon_width * icon_height * 4;
-                uint32_t data_buflen = xcb_get_property_value_length(prop_reply);
-                if (data_buflen >= (imgdat_size + 8))
-                {
-                    uchar *imgdat = (uchar *)malloc(imgdat_size);
-                    if (imgdat)
-                    {
-                        memcpy(imgdat, &data[2], imgdat_size);
-                        QImage iconImage(imgdat, icon_width, icon_height, QImage::Format_ARGB32, free, imgdat);
-                        ret = QPixmap::fromImage(iconImage);
-                    }
-                }
-            }
-            else
-            {
-                // unknown format
-                if (data_fmt) qDebug() << "WinInfo::GetPixmap: window icon has unrecognized format " << data_fmt;
-            }
-            free(prop_reply);
+            fetch.icons = IconStore::Get(c, xcb_win);
+            fetch.fetched = true;
         }
-        xcbEventFilter::errorHandler("WinInfo::GetPixmap: get_property _NET_WM_ICON: ", &err);
+        if (fetch.icons) ret = NetWmIcon::Pick(*fetch.icons, icon_size);
     }
     // fall back to default icon
-    if (ret.isNull()) ret = QPixmap(":/resource/images/Default.png");
-    qDebug() << "WinInfo::GetPixmap: returning pixmap: " << ret;
+    if (ret.isNull()) ret = IconStore::Default(icon_size);
+    qCDebug(lcStats) << "WinInfo::CaptureImage: returning image: " << ret.size();
     return ret;
 }
 
@@ -132,27 +151,54 @@ void WinInfo::SetTitle(const QString &newtit)
     win_title = newtit;
 }
 
-void WinInfo::UpdatePixmap()
+WinInfo::PixmapRequest WinInfo::RequestPixmap() const
+{
+    // named first and asked about after, since the server answers in order
+    // the attributes are the ones it was named under
+    PixmapRequest request;
+    request.id = xcb_generate_id(connection);
+    request.attributes = xcb_get_window_attributes(connection, xcb_win);
+    request.geometry = xcb_get_geometry(connection, xcb_win);
+    request.name = xcb_composite_name_window_pixmap_checked(connection, xcb_win, request.id);
+    xcb_flush(connection);
+    return request;
+}
+
+void WinInfo::CollectPixmap(const PixmapRequest &request)
 {
-    xcb_void_cookie_t void_cookie;
-    xcb_generic_error_t *err;
-    if (pm_alloced)
+    xcb_generic_error_t *err = nullptr;
+    xcb_get_window_attributes_reply_t *ga_reply = xcb_get_window_attributes_reply(connection, request.attributes, &err);
+    xcbEventFilter::errorHandler("WinInfo::CollectPixmap: get_window_attributes: ", &err);
+    xcb_get_geometry_reply_t *gg_reply = xcb_get_geometry_reply(connection, request.geometry, &err);
+    xcbEventFilter::errorHandler("WinInfo::CollectPixmap: get_geometry: ", &err);
+    xcb_generic_error_t *name_err = xcb_request_check(connection, request.name);
+    bool named = !name_err;
+    bool showing = ga_reply && ga_reply->map_state != XCB_MAP_STATE_UNMAPPED && !ga_reply->override_redirect;
+    // an unmapped window can't be named, that's no news
+    if (!showing) free(name_err);
+    else xcbEventFilter::errorHandler("WinInfo::CollectPixmap: name_window_pixmap: ", &name_err);
+    if (showing && named && gg_reply)
     {
-        void_cookie = xcb_free_pixmap_checked(connection, xcb_pm);
-        err = xcb_request_check(connection, void_cookie);
-        if (!xcbEventFilter::errorHandler("WinInfo::UpdatePixmap: free_pixmap: ", &err)) pm_alloced = false;
+        xcb_vis = ga_reply->visual;
+        win_width = gg_reply->width;
+        win_height = gg_reply->height;
+        win_depth = gg_reply->depth;
+        pixmap.reset(new NamedPixmap(connection, request.id));
     }
-    xcb_get_window_attributes_cookie_t ga_cookie = xcb_get_window_attributes(connection, xcb_win);
-    xcb_get_window_attributes_reply_t *ga_reply = xcb_get_window_attributes_reply(connection, ga_cookie, &err);
-    if (ga_reply)
+    else
     {
-        if (ga_reply->map_state != XCB_MAP_STATE_UNMAPPED && !ga_reply->override_redirect)
-        {
-            void_cookie = xcb_composite_name_window_pixmap_checked(connection, xcb_win, xcb_pm);
-            xcb_generic_error_t *err2 = xcb_request_check(connection, void_cookie);
-            if (!xcbEventFilter::errorHandler("WinInfo::UpdatePixmap: name_window_pixmap: ", &err2)) pm_alloced = true;
-        }
-        free(ga_reply);
+        if (named) xcb_free_pixmap(connection, request.id);
+        pixmap.reset();
     }
-    xcbEventFilter::errorHandler("WinInfo::UpdatePixmap: get_window_attributes: ", &err);
+    free(ga_reply);
+    free(gg_reply);
+}
+
+void WinInfo::DiscardPixmap(xcb_connection_t *c, const PixmapRequest &request)
+{
+    xcb_discard_reply(c, request.attributes.sequence);
+    xcb_discard_reply(c, request.geometry.sequence);
+    xcb_generic_error_t *err = xcb_request_check(c, request.name);
+    if (!err) xcb_free_pixmap(c, request.id);
+    free(err);
 }
@@ -19,35 +19,98 @@ along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef WININFO_H
 #define WININFO_H
 
-#include <QObject>
 #include <QPixmap>
+#include <QImage>
+#include <QString>
+#include <QSharedPointer>
+#include "iconstore.h"
 #include <xcb/xcb.h>
 
-class WinInfo : public QObject
+class CaptureContext;
+
+// What the icon box needs to know to draw a window.  This is a plain value:
+// copies share the same server side pixmap, which is freed once the last
+// copy lets go of it.  Every rename gets a pixmap of its own, so a capture
+// holding an older copy keeps reading what it started with.
+class WinInfo
 {
-    Q_OBJECT
 public:
-    explicit WinInfo(xcb_window_t win_id, const QString &title = QString("(unknown)"), QObject *parent = nullptr);
-    ~WinInfo();
-    QPixmap GetPixmap(bool updatenwp = false);
+    WinInfo();
+    explicit WinInfo(xcb_window_t win_id, const QString &title = QString("(unknown)"));
+    // the window's own icons as a capture found them.  they're handed back
+    // to the original through KeepIcons() so the next capture doesn't have
+    // to fetch and parse them again.
+    struct IconFetch
+    {
+        IconFetch() : fetched(false), serial(0), from_contents(false) { }
+        IconStore::Icons icons;
+        bool fetched;
+        quint32 serial;
+        // the capture was of the window itself rather than one of its
+        // icons or the default one
+        bool from_contents;
+    };
+    // the capture (or the window's icon, or the default one) scaled to fit
+    // icon_size, on any thread and connection.  it works from a copy, so
+    // whatever it learns about the window's icons goes into fetch.
+    QImage CaptureIcon(CaptureContext &ctx, int icon_size, IconFetch *fetch) const;
+    // takes on the icons a capture fetched, unless they've changed since
+    void KeepIcons(const IconFetch &fetch);
     QString GetTitle() const;
-
-signals:
-
-public slots:
+    QSize GetSize() const { return QSize(win_width, win_height); }
+    bool HasPixmap() const { return !pixmap.isNull(); }
     void SetTitle(const QString &newtit);
-    void UpdatePixmap();
+    // what RequestPixmap() sent, for CollectPixmap() to pick up
+    struct PixmapRequest
+    {
+        xcb_get_window_attributes_cookie_t attributes;
+        xcb_get_geometry_cookie_t geometry;
+        xcb_void_cookie_t name;
+        xcb_pixmap_t id;
+    };
+    // names a new pixmap for the window's contents without waiting on anything
+    PixmapRequest RequestPixmap() const;
+    // only once everything up to the request has been answered (see
+    // XcbReplyQueue::AfterPending), so none of this waits.  takes the new
+    // pixmap and size, or drops the pixmap if the window isn't showing.
+    void CollectPixmap(const PixmapRequest &request);
+    // the same, for a window that went away in the meantime
+    static void DiscardPixmap(xcb_connection_t *c, const PixmapRequest &request);
+    // _NET_WM_ICON changed, so the icons we parsed out of it are no good
+    void IconChanged();
+    void Release();
 
 private:
     xcb_connection_t *connection;
     xcb_window_t xcb_win;
-    xcb_pixmap_t xcb_pm;
+    // freed by whichever copy lets go of it last, on whatever thread that is
+    struct NamedPixmap
+    {
+        NamedPixmap(xcb_connection_t *c, xcb_pixmap_t pm) : connection(c), id(pm) { }
+        ~NamedPixmap();
+        xcb_connection_t *connection;
+        xcb_pixmap_t id;
+    };
+    QSharedPointer<NamedPixmap> pixmap;
+    // what the pixmap was named with
     xcb_visualid_t xcb_vis;
     uint16_t win_width, win_height;
     uint8_t win_depth;
     QString win_title;
-    bool pm_alloced;
+    // shared with every other window showing the same icon
+    IconStore::Icons wm_icons;
+    bool wm_icons_fetched;
+    // bumped by IconChanged() so icons fetched before it aren't kept
+    quint32 icons_serial;
+    // icon_size picks which of the window's own icons to fall back to, 0 for
+    // the biggest.  fetch is where the window's icons are kept and where it
+    // says what the image came from.  the image may point into the shm
+    // segment, so it has to be used up before the next capture.
+    QImage CaptureImage(CaptureContext &ctx, int icon_size, IconFetch &fetch) const;
+    QImage MakeIcon(CaptureContext &ctx, int icon_size, IconFetch &fetch) const;
 
 };
 
+Q_DECLARE_METATYPE(WinInfo::IconFetch)
+
 #endif // WININFO_H
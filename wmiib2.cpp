@@ -27,23 +27,36 @@ along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
 #include <QTimer>
 #include <QMouseEvent>
 #include "xcbeventfilter.h"
+#include "xcbeventthread.h"
+#include "xcbreplyqueue.h"
 #include <xcb/xcb.h>
 #include <xcb/composite.h>
 #include <xcb/damage.h>
 #include <QQueue>
-#include "atomcache.h"
+#include "ewmhatoms.h"
 #include <QMenu>
 #include <QBitmap>
 #include <QPainter>
 #include <QRect>
 #include "settingswindow.h"
+#include "thumbnailcache.h"
+#include "capturepool.h"
+#include "persistentthumbnails.h"
+#include "iconstore.h"
 #include <QMessageBox>
 #include <QDateTime>
+#include <algorithm>
 #include <unistd.h>
 
 // the amount of grace time before an unmapped window is considered
 // iconified if it hasn't yet been destroyed, in msec.
 #define UNMAP_DESTROY_GRACE 300LL
+// how often mapped windows get their icon captured ahead of time, in msec,
+// and how much one pass is allowed to cost: time spent, and bytes of window
+// pulled from the server.  windows that haven't changed cost nothing.
+#define SNAPSHOT_INTERVAL 2000
+#define SNAPSHOT_MAX_QUEUED 4
+#define SNAPSHOT_BYTES_PER_PASS (16LL * 1024 * 1024)
 
 wmiib2::wmiib2(QWidget *parent) :
     QWidget(parent, Qt::FramelessWindowHint),
@@ -51,7 +64,16 @@ wmiib2::wmiib2(QWidget *parent) :
 {
     ui->setupUi(this);
 
-    evfilt = new xcbEventFilter;
+    // intern everything we know we'll need in one round trip
+    EwmhAtoms::Resolve();
+
+    evfilt = nullptr;
+    evthread = nullptr;
+    unmapped_count = 0;
+    thumbs = nullptr;
+    captures = nullptr;
+    saved = nullptr;
+    replies = nullptr;
 
     comp_version_ok = false;
     connection = QX11Info::connection();
@@ -59,12 +81,12 @@ wmiib2::wmiib2(QWidget *parent) :
     setWindowFlags(Qt::FramelessWindowHint);
     xcb_window_t mywin = (xcb_window_t)winId();
 
-    xcb_atom_t net_wm_state = AtomCache::GetAtom("_NET_WM_STATE");
-    xcb_atom_t net_wm_state_below = AtomCache::GetAtom("_NET_WM_STATE_BELOW");
-    xcb_atom_t net_wm_state_sticky = AtomCache::GetAtom("_NET_WM_STATE_STICKY");
-    xcb_atom_t net_wm_state_skip_taskbar = AtomCache::GetAtom("_NET_WM_STATE_SKIP_TASKBAR");
-    xcb_atom_t net_wm_window_type = AtomCache::GetAtom("_NET_WM_WINDOW_TYPE");
-    xcb_atom_t net_wm_window_type_dock = AtomCache::GetAtom("_NET_WM_WINDOW_TYPE_DOCK");
+    const xcb_atom_t net_wm_state = EwmhAtoms::Get(EwmhAtoms::NET_WM_STATE);
+    const xcb_atom_t net_wm_state_below = EwmhAtoms::Get(EwmhAtoms::NET_WM_STATE_BELOW);
+    const xcb_atom_t net_wm_state_sticky = EwmhAtoms::Get(EwmhAtoms::NET_WM_STATE_STICKY);
+    const xcb_atom_t net_wm_state_skip_taskbar = EwmhAtoms::Get(EwmhAtoms::NET_WM_STATE_SKIP_TASKBAR);
+    const xcb_atom_t net_wm_window_type = EwmhAtoms::Get(EwmhAtoms::NET_WM_WINDOW_TYPE);
+    const xcb_atom_t net_wm_window_type_dock = EwmhAtoms::Get(EwmhAtoms::NET_WM_WINDOW_TYPE_DOCK);
     uint32_t prop_arr[] = {
         net_wm_window_type_dock,
         0,
@@ -102,9 +124,18 @@ wmiib2::wmiib2(QWidget *parent) :
     MyPalette.setColor(QPalette::Window, setwin->GetBackgroundColor());
     setPalette(MyPalette);
     saved_icon_size = setwin->GetIconSize();
+    thumbs = new ThumbnailCache(setwin->GetThumbnailCacheBytes());
+    saved = new PersistentThumbnails;
+    connect(saved, SIGNAL(Loaded(uint,QByteArray,QImage)), this, SLOT(thumbnailLoaded(uint,QByteArray,QImage)));
+    replies = new XcbReplyQueue(connection, this);
+    captures = new CapturePool(this);
+    connect(captures, SIGNAL(IconReady(xcb_window_t,quint32,quint32,int,QImage,WinInfo::IconFetch)), this, SLOT(iconReady(xcb_window_t,quint32,quint32,int,QImage,WinInfo::IconFetch)));
     // create timer and connect it
     iTimer = new QTimer(this);
     connect(iTimer, SIGNAL(timeout()), this, SLOT(DelayedIconCreator()));
+    snapshot_passes = 0;
+    sTimer = new QTimer(this);
+    connect(sTimer, SIGNAL(timeout()), this, SLOT(TakeSnapshots()));
     // set up the layouts that will hold our icons
     ui->horizontalLayout->setContentsMargins(2, 2, 2, 2);
     itemOuterLayout = new QBoxLayout(setwin->GetOuterLayoutDirection(), ui->frame);
@@ -120,25 +151,54 @@ wmiib2::wmiib2(QWidget *parent) :
     itemOuterLayout->setAlignment(innerLayout, setwin->GetIconAlignment());
     itemInnerLayouts.append(innerLayout);
     // set up and install event filter.
-    connect(evfilt, SIGNAL(WindowMapped(xcb_window_t,QString)), this, SLOT(winMapped(xcb_window_t,QString)));
-    connect(evfilt, SIGNAL(WindowDestroyed(xcb_window_t)), this, SLOT(winDestroyed(xcb_window_t)));
-    connect(evfilt, SIGNAL(WindowIconified(xcb_window_t)), this, SLOT(winIconified(xcb_window_t)));
-    connect(evfilt, SIGNAL(WindowDamaged(xcb_window_t)), this, SLOT(winDamaged(xcb_window_t)));
-    connect(evfilt, SIGNAL(WindowResized(xcb_window_t,QSize)), this, SLOT(winResized(xcb_window_t,QSize)));
-    connect(evfilt, SIGNAL(WindowTitleChanged(xcb_window_t,QString)), this, SLOT(winTitleChanged(xcb_window_t,QString)));
-    evfilt->Startup();
-    qGuiApp->installNativeEventFilter(evfilt);
+    // either it runs on its own thread and talks to us through evthread, or
+    // it sees Qt's own events on this thread.
+    QObject *events;
+    if (setwin->UsesEventThread())
+    {
+        evthread = new XcbEventThread(this);
+        if (!evthread->IsValid())
+        {
+            delete evthread;
+            evthread = nullptr;
+        }
+    }
+    if (evthread) events = evthread;
+    else events = evfilt = new xcbEventFilter(connection);
+    connect(events, SIGNAL(WindowMapped(xcb_window_t,QString)), this, SLOT(winMapped(xcb_window_t,QString)));
+    connect(events, SIGNAL(WindowDestroyed(xcb_window_t)), this, SLOT(winDestroyed(xcb_window_t)));
+    connect(events, SIGNAL(WindowIconified(xcb_window_t)), this, SLOT(winIconified(xcb_window_t)));
+    connect(events, SIGNAL(WindowDamaged(xcb_window_t)), this, SLOT(winDamaged(xcb_window_t)));
+    connect(events, SIGNAL(WindowResized(xcb_window_t,QSize)), this, SLOT(winResized(xcb_window_t,QSize)));
+    connect(events, SIGNAL(WindowTitleChanged(xcb_window_t,QString)), this, SLOT(winTitleChanged(xcb_window_t,QString)));
+    connect(events, SIGNAL(WindowIconChanged(xcb_window_t)), this, SLOT(winIconChanged(xcb_window_t)));
+    if (evthread)
+    {
+        evthread->Start();
+    }
+    else
+    {
+        evfilt->Startup();
+        qGuiApp->installNativeEventFilter(evfilt);
+    }
+    sTimer->start(SNAPSHOT_INTERVAL);
     AdjustFrameSize();
 }
 
 wmiib2::~wmiib2()
 {
+    // nothing that's still on its way is wanted anymore
+    delete replies;
+    // the workers may still be delivering into the cache
+    delete captures;
+    delete thumbs;
+    delete saved;
     delete ui;
 }
 
 void wmiib2::errorHandler(const QString &prefix, xcb_generic_error_t **errp)
 {
-    if (evfilt) evfilt->errorHandler(QString("wmiib2::%1").arg(prefix), errp);
+    xcbEventFilter::errorHandler(QString("wmiib2::%1").arg(prefix), errp);
 }
 
 void wmiib2::changeEvent(QEvent *e)
@@ -158,14 +218,14 @@ void wmiib2::mousePressEvent(QMouseEvent *e)
     QWidget *wat = ui->frame->childAt(ui->frame->mapFrom(this, e->pos()));
     if (e->button() == Qt::LeftButton && wat)
     {
-        QMap<xcb_window_t, QLabel *>::iterator p;
-        for (p = win_icon.begin(); p != win_icon.end(); ++p)
+        xcb_window_t clicked = 0UL;
+        windows.ForEach([wat, &clicked](xcb_window_t win, const window_entry &entry) {
+            if (entry.icon && entry.icon == wat) clicked = win;
+        });
+        if (clicked)
         {
-            if (p.value() == wat)
-            {
-                DeiconifyWindow(p.key());
-                e->accept();
-            }
+            DeiconifyWindow(clicked);
+            e->accept();
         }
     }
     else
@@ -210,41 +270,53 @@ void wmiib2::paintEvent(QPaintEvent *e)
 void wmiib2::winMapped(xcb_window_t win, const QString &title)
 {
     //qDebug() << "wmiib2::winMapped(" << win << ", " << title << ")";
-    if (!(win_info.contains(win) && win_info[win]))
+    window_entry *entry = windows.Find(win);
+    if (!entry)
     {
         xcb_void_cookie_t void_cookie = xcb_composite_redirect_window_checked(connection, win, XCB_COMPOSITE_REDIRECT_AUTOMATIC);
         xcb_generic_error_t *err = xcb_request_check(connection, void_cookie);
         //if (err) TODO: redirect failed
         errorHandler("wmiib2:winMapped: composite_redirect_window", &err);
-        win_info[win] = new WinInfo(win, title);
+        entry = &windows.Insert(win);
+        entry->info = WinInfo(win, title);
+        // asked for first so it's in by the time the identity is
+        RefreshPixmap(win);
+        // who it belongs to is only needed later, so don't wait for it
+        PersistentThumbnails::IdentityRequest request = PersistentThumbnails::RequestIdentity(connection, win);
+        quint32 generation = windows.Generation(win);
+        replies->AfterPending([this, win, generation, request]() {
+            QByteArray identity = PersistentThumbnails::Identify(connection, request);
+            window_entry *entry = windows.Find(win, generation);
+            if (!entry) return;
+            entry->identity = identity;
+            // already iconified when we started, so all there is to show is
+            // what the last run saved
+            if (!entry->info.HasPixmap() && !identity.isEmpty() && !entry->snapshot_of_contents) saved->Load(win, identity);
+        });
     }
     else
     {
-        win_info[win]->SetTitle(title);
-        win_info[win]->UpdatePixmap();
-    }
-    if (unmapped_wins.contains(win))
-    {
-        unmapped_wins.remove(win);
-        if (unmapped_wins.isEmpty() && iTimer->isActive()) iTimer->stop();
+        entry->info.SetTitle(title);
+        RefreshPixmap(win);
+        ++entry->content;
     }
+    ClearUnmapped(*entry);
     RemoveWindowIcon(win);
 }
 
 void wmiib2::winDestroyed(xcb_window_t win)
 {
     //qDebug() << "wmiib2::winDestroyed(" << win << ")";
-    if (win_info.contains(win))
+    if (window_entry *entry = windows.Find(win))
     {
-        if (win_info[win]) win_info[win]->deleteLater();
-        win_info.remove(win);
-        if (unmapped_wins.contains(win))
-        {
-            unmapped_wins.remove(win);
-            if (unmapped_wins.isEmpty() && iTimer->isActive()) iTimer->stop();
-        }
+        ClearUnmapped(*entry);
+        RemoveWindowIcon(win);
+        entry->info.Release();
+        captures->Cancel(win);
+        thumbs->Remove(win);
+        saved->Remove(win);
+        windows.Remove(win);
     }
-    RemoveWindowIcon(win);
 }
 
 void wmiib2::winDamaged(xcb_window_t win)
@@ -252,46 +324,62 @@ void wmiib2::winDamaged(xcb_window_t win)
     //qDebug() << "wmiib2::winDamaged(" << win << ")";
     // only worry about iconified windows that are damaged
     // this makes no sense.  iconified windows are unmapped and can't be damaged.
-    if (win_icon.contains(win) && win_icon[win] && win_info.contains(win) && win_info[win])
+    window_entry *entry = windows.Find(win);
+    if (!entry) return;
+    ++entry->content;
+    if (entry->icon)
     {
-        win_icon[win]->setPixmap(win_info[win]->GetPixmap(true));
+        // keep showing the old one until the new one is ready
+        QPixmap win_pm = IconFor(win, *entry, saved_icon_size, CapturePool::PRIORITY_VISIBLE, true);
+        if (!win_pm.isNull()) entry->icon->setPixmap(win_pm);
     }
 }
 
 void wmiib2::winResized(xcb_window_t win, const QSize &)
 {
     //qDebug() << "wmiib2::winResized(" << win << ", " << newSize << ")";
-    if (win_info.contains(win) && win_info[win])
+    if (window_entry *entry = windows.Find(win))
     {
-        win_info[win]->UpdatePixmap();
+        RefreshPixmap(win);
+        ++entry->content;
     }
 }
 
 void wmiib2::winIconified(xcb_window_t win)
 {
     //qDebug() << "wmiib2::winIconified(" << win << ")";
-    // should always be true
-    if (win_info.contains(win) && win_info[win])
+    // should always be found
+    window_entry *entry = windows.Find(win);
+    if (entry && !entry->unmapped)
     {
-        if (!unmapped_wins.contains(win))
-        {
-            unmapped_wins[win] = QDateTime::currentDateTimeUtc().addMSecs(UNMAP_DESTROY_GRACE);
-            if (!iTimer->isActive()) iTimer->start(UNMAP_DESTROY_GRACE + 1LL);
-        }
+        entry->unmapped = true;
+        entry->unmap_deadline = QDateTime::currentDateTimeUtc().addMSecs(UNMAP_DESTROY_GRACE);
+        ++unmapped_count;
+        if (!iTimer->isActive()) iTimer->start(UNMAP_DESTROY_GRACE + 1LL);
     }
 }
 
 void wmiib2::winTitleChanged(xcb_window_t win, const QString &title)
 {
     //qDebug() << "wmiib2::winTitleChanged(" << win << ", " << title << ")";
-    if (win_info.contains(win) && win_info[win]) win_info[win]->SetTitle(title);
-    if (win_icon.contains(win) && win_icon[win]) win_icon[win]->setToolTip(title);
+    if (window_entry *entry = windows.Find(win))
+    {
+        entry->info.SetTitle(title);
+        if (entry->icon) entry->icon->setToolTip(title);
+    }
+}
+
+void wmiib2::winIconChanged(xcb_window_t win)
+{
+    //qDebug() << "wmiib2::winIconChanged(" << win << ")";
+    // only matters the next time the window can't be captured
+    if (window_entry *entry = windows.Find(win)) entry->info.IconChanged();
 }
 
 void wmiib2::DeiconifyWindow(xcb_window_t win)
 {
     //qDebug() << "wmiib2::DeiconifyWindow(" << win << ")";
-    static xcb_atom_t net_active_window = AtomCache::GetAtom("_NET_ACTIVE_WINDOW");
+    const xcb_atom_t net_active_window = EwmhAtoms::Get(EwmhAtoms::NET_ACTIVE_WINDOW);
 
     xcb_query_tree_cookie_t qtree_cookie = xcb_query_tree(connection, win);
     xcb_generic_error_t *err = nullptr;
@@ -425,19 +513,18 @@ void wmiib2::GenerateMask()
         bitmap.clear();
         QPainter painter(&bitmap);
         painter.setBrush(QBrush(Qt::color1));
-        QMap<xcb_window_t, QLabel *>::iterator p;
-        for (p = win_icon.begin(); p != win_icon.end(); ++p)
-        {
-            QPoint winpos = p.value()->mapTo(this, QPoint(0, 0));
-            QRect winrect(winpos, p.value()->size());
-            QImage icon_mask = p.value()->pixmap()->toImage().createAlphaMask(Qt::ThresholdAlphaDither);
+        windows.ForEach([this, &painter](xcb_window_t, const window_entry &entry) {
+            if (!entry.icon) return;
+            QPoint winpos = entry.icon->mapTo(this, QPoint(0, 0));
+            QRect winrect(winpos, entry.icon->size());
+            QImage icon_mask = entry.icon->pixmap()->toImage().createAlphaMask(Qt::ThresholdAlphaDither);
             // this doesn't give a very nice mask and it's a heavy operation
-            // QImage icon_mask = p.value()->pixmap()->createHeuristicMask(true).toImage();
+            // QImage icon_mask = entry.icon->pixmap()->createHeuristicMask(true).toImage();
             // TODO: add a border to the mask
             if (icon_mask.isNull())
                 painter.fillRect(winrect.marginsAdded(QMargins(1, 1, 1, 1)), Qt::color1);
             else painter.drawImage(winrect, icon_mask);
-        }
+        });
         int btnX = setwin->IsFromLeft() ? 1 : width() - 9;
         int btnY = setwin->IsFromTop() ? 1 : height() - 9;
         painter.drawRoundRect(btnX, btnY, 8, 8, 2, 2);
@@ -487,22 +574,19 @@ void wmiib2::SettingsChanged()
         while (labels.count())
         {
             QLabel *label = labels.takeFirst();
-            QMap<xcb_window_t, QLabel *>::iterator p;
-            for (p = win_icon.begin(); p != win_icon.end(); ++p)
-            {
-                if (p.value() == label)
-                {
-                    // found -- update pixmap
-                    QPixmap win_pm = win_info[p.key()]->GetPixmap().scaled(icon_size, icon_size, Qt::KeepAspectRatio);
-                    label->setPixmap(win_pm);
-                    label->setFixedSize(win_pm.size());
-                    break;
-                }
-            }
+            windows.ForEach([this, label, icon_size](xcb_window_t win, window_entry &entry) {
+                if (entry.icon != label) return;
+                // found -- update pixmap
+                QPixmap win_pm = IconFor(win, entry, icon_size, CapturePool::PRIORITY_VISIBLE);
+                if (win_pm.isNull()) win_pm = Placeholder(icon_size);
+                label->setPixmap(win_pm);
+                label->setFixedSize(win_pm.size());
+            });
             AddWidgetToLayout(label);
         }
         saved_icon_size = icon_size;
     }
+    thumbs->SetMaxBytes(setwin->GetThumbnailCacheBytes());
     AdjustFrameSize();
     // force redraw?
     update();
@@ -510,9 +594,10 @@ void wmiib2::SettingsChanged()
 
 void wmiib2::RemoveWindowIcon(xcb_window_t win)
 {
-    if (win_icon.contains(win))
+    window_entry *entry = windows.Find(win);
+    if (entry && entry->icon)
     {
-        if (QLabel *label = win_icon[win])
+        if (QLabel *label = entry->icon)
         {
             // find the layout that contains it
             int containingLayout = -1;
@@ -538,15 +623,126 @@ void wmiib2::RemoveWindowIcon(xcb_window_t win)
             if (containerItem)
             {
                 itemInnerLayouts.at(containingLayout)->removeItem(containerItem);
-                win_icon[win]->deleteLater();
+                label->deleteLater();
                 TryToShiftItemInLayout(containingLayout + 1);
             }
+            // not laid out yet (see DelayedIconCreator) but still ours to delete
+            else label->deleteLater();
         }
-        win_icon.remove(win);
+        entry->icon = nullptr;
         AdjustFrameSize();
     }
 }
 
+QPixmap wmiib2::IconFor(xcb_window_t win, window_entry &entry, int icon_size, CapturePool::Priority priority, bool updatenwp)
+{
+    QPixmap ret = thumbs->Find(win, windows.Generation(win), entry.content, icon_size);
+    if (!ret.isNull()) return ret;
+    // asking twice is fine, the pool keeps one request per window
+    if (!updatenwp && entry.info.HasPixmap())
+    {
+        captures->Request(win, windows.Generation(win), entry.content, icon_size, entry.info, priority);
+        return ret;
+    }
+    // the worker reads the window's pixmap as it is, so make it current first
+    RefreshPixmap(win, [this, win, icon_size, priority](window_entry &entry) {
+        captures->Request(win, windows.Generation(win), entry.content, icon_size, entry.info, priority);
+    });
+    return ret;
+}
+
+void wmiib2::RefreshPixmap(xcb_window_t win, const std::function<void(window_entry &)> &then)
+{
+    window_entry *entry = windows.Find(win);
+    if (!entry) return;
+    WinInfo::PixmapRequest request = entry->info.RequestPixmap();
+    quint32 generation = windows.Generation(win);
+    replies->AfterPending([this, win, generation, request, then]() {
+        window_entry *entry = windows.Find(win, generation);
+        if (!entry)
+        {
+            WinInfo::DiscardPixmap(connection, request);
+            return;
+        }
+        entry->info.CollectPixmap(request);
+        if (then) then(*entry);
+    });
+}
+
+QPixmap wmiib2::Placeholder(int icon_size)
+{
+    if (placeholder.isNull() || qMax(placeholder.width(), placeholder.height()) != icon_size)
+    {
+        placeholder = QPixmap::fromImage(IconStore::Default(icon_size));
+    }
+    return placeholder;
+}
+
+void wmiib2::iconReady(xcb_window_t win, quint32 generation, quint32 content, int icon_size, const QImage &icon, const WinInfo::IconFetch &icons)
+{
+    window_entry *entry = windows.Find(win, generation);
+    if (!entry) return;
+    // whatever the snapshot turns out to be worth, the icons are still good
+    entry->info.KeepIcons(icons);
+    // a slightly stale snapshot is still better than none, it just gets
+    // kept under the contents it was taken of.  only a different icon size
+    // or one older than what we already have makes it useless, and the
+    // window's icon (or the default one) never beats a picture of the
+    // window, even one the last run saved.
+    if (icon_size != saved_icon_size || icon.isNull()) return;
+    if (entry->snapshot_taken && (qint32)(content - entry->snapshot_content) < 0) return;
+    if (entry->snapshot_taken && entry->snapshot_of_contents && !icons.from_contents) return;
+    QPixmap win_pm = QPixmap::fromImage(icon);
+    thumbs->Insert(win, generation, content, icon_size, win_pm);
+    entry->snapshot_taken = true;
+    entry->snapshot_content = content;
+    entry->snapshot_of_contents = icons.from_contents;
+    if (entry->icon)
+    {
+        entry->icon->setPixmap(win_pm);
+        entry->icon->setFixedSize(win_pm.size());
+        if (icons.from_contents) SaveSnapshot(win, *entry, icon);
+    }
+}
+
+void wmiib2::thumbnailLoaded(uint win, const QByteArray &identity, const QImage &icon)
+{
+    // the window id may have been handed to someone else since
+    window_entry *entry = windows.Find(win);
+    if (!entry || entry->identity != identity) return;
+    // a capture of the window beat it to it; one of its icon didn't
+    if (entry->info.HasPixmap() || entry->snapshot_of_contents) return;
+    quint32 generation = windows.Generation(win);
+    thumbs->Insert(win, generation, entry->content, qMax(icon.width(), icon.height()), QPixmap::fromImage(icon));
+    entry->snapshot_taken = true;
+    entry->snapshot_content = entry->content;
+    entry->snapshot_of_contents = true;
+    // it may have been given an icon while we waited
+    if (entry->icon)
+    {
+        QPixmap win_pm = thumbs->Find(win, generation, entry->content, saved_icon_size);
+        if (!win_pm.isNull())
+        {
+            entry->icon->setPixmap(win_pm);
+            entry->icon->setFixedSize(win_pm.size());
+        }
+    }
+}
+
+void wmiib2::SaveSnapshot(xcb_window_t win, const window_entry &entry, const QImage &icon)
+{
+    // without a pixmap it's only the window's own icon or the default one,
+    // which would be no better than what the next run gets anyway
+    if (entry.icon && entry.info.HasPixmap() && !entry.identity.isEmpty()) saved->Store(win, entry.identity, icon);
+}
+
+void wmiib2::ClearUnmapped(window_entry &entry)
+{
+    if (!entry.unmapped) return;
+    entry.unmapped = false;
+    if (!--unmapped_count && iTimer->isActive()) iTimer->stop();
+}
+
 void wmiib2::AddWidgetToLayout(QLabel *newItem)
 {
     // find a layout with enough room
@@ -667,47 +863,95 @@ int wmiib2::GetLayoutSize(int layoutIndex)
 void wmiib2::DelayedIconCreator()
 {
     iTimer->stop();
-    QMap<xcb_window_t, QDateTime>::iterator p;
     QList<xcb_window_t> iconified_wins;
     QDateTime now = QDateTime::currentDateTimeUtc();
     qint64 next_event = 0LL;
-    for (p = unmapped_wins.begin(); p != unmapped_wins.end(); ++p)
-    {
-        if (p.value() <= now)
+    windows.ForEach([&iconified_wins, &now, &next_event](xcb_window_t win, const window_entry &entry) {
+        if (!entry.unmapped) return;
+        if (entry.unmap_deadline <= now)
         {
-            iconified_wins.append(p.key());
+            iconified_wins.append(win);
         }
         else
         {
-            qint64 msto = now.msecsTo(p.value());
+            qint64 msto = now.msecsTo(entry.unmap_deadline);
             if ((!next_event) || (msto < next_event)) next_event = msto;
         }
-    }
+    });
+    QWidgetList widgetlist;
     for (int i = 0; i < iconified_wins.count(); ++i)
     {
         xcb_window_t win = iconified_wins.at(i);
+        window_entry *entry = windows.Find(win);
         // I've waited long enough!
-        if (!(win_icon.contains(win) && win_icon[win]))
+        if (!entry->icon)
         {
-            // should always be true
             QLabel *newItem = new QLabel(ui->frame);
-            QPixmap win_pm = win_info[win]->GetPixmap(false).scaled(saved_icon_size, saved_icon_size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            // by now the window manager may have let go of the contents, so
+            // whatever the snapshot timer last saw beats capturing again
+            QPixmap win_pm;
+            if (entry->snapshot_taken) win_pm = thumbs->Find(win, windows.Generation(win), entry->snapshot_content, saved_icon_size);
+            if (win_pm.isNull()) win_pm = IconFor(win, *entry, saved_icon_size, CapturePool::PRIORITY_ICONIFIED);
+            // a capture still on its way gets saved when it's ready
+            bool captured = !win_pm.isNull();
+            if (!captured) win_pm = Placeholder(saved_icon_size);
             newItem->setPixmap(win_pm);
             newItem->setFixedSize(win_pm.size());
-            newItem->setToolTip(win_info[win]->GetTitle());
+            newItem->setToolTip(entry->info.GetTitle());
             // find the place to insert into layouts
-            win_icon[win] = newItem;
+            entry->icon = newItem;
+            if (captured) SaveSnapshot(win, *entry, win_pm.toImage());
         }
-        unmapped_wins.remove(win);
+        widgetlist.append(entry->icon);
+        entry->unmapped = false;
+        --unmapped_count;
     }
     if (iconified_wins.count())
     {
-        QWidgetList widgetlist;
-        for (xcb_window_t win : iconified_wins) widgetlist.append(win_icon[win]);
         AdjustFrameSize(widgetlist);
         usleep(100000L);
         QApplication::processEvents();
-        for (xcb_window_t win : iconified_wins) AddWidgetToLayout(win_icon[win]);
+        // the window may have gone away while we were processing events
+        for (int i = 0; i < iconified_wins.count(); ++i)
+        {
+            window_entry *entry = windows.Find(iconified_wins.at(i));
+            if (entry && entry->icon == widgetlist.at(i)) AddWidgetToLayout(entry->icon);
+        }
     }
     if (next_event) iTimer->start(next_event + 1LL);
 }
+
+void wmiib2::TakeSnapshots()
+{
+    // keep a current icon for every window that's on screen so it's ready
+    // the moment the window gets iconified
+    struct candidate
+    {
+        xcb_window_t win;
+        quint64 pass;
+    };
+    ++snapshot_passes;
+    QVector<candidate> todo;
+    windows.ForEach([this, &todo](xcb_window_t win, const window_entry &entry) {
+        if (entry.icon || entry.unmapped) return;
+        if (entry.snapshot_taken && entry.snapshot_content == entry.content) return;
+        // already on its way
+        if (captures->IsWanted(win, entry.content)) return;
+        candidate c = {win, entry.snapshot_taken ? entry.snapshot_pass : 0};
+        todo.append(c);
+    });
+    // whoever has waited longest goes first, so the budget doesn't starve anyone
+    std::stable_sort(todo.begin(), todo.end(), [](const candidate &a, const candidate &b) { return a.pass < b.pass; });
+    qint64 bytes = 0;
+    for (int i = 0; i < todo.count(); ++i)
+    {
+        // the pool runs at idle priority; if it's still busy there's no
+        // cpu to spare for more, and the bytes cap keeps the wire quiet
+        if (captures->Pending() >= SNAPSHOT_MAX_QUEUED || bytes >= SNAPSHOT_BYTES_PER_PASS) break;
+        window_entry *entry = windows.Find(todo.at(i).win);
+        QSize size = entry->info.GetSize();
+        bytes += (qint64)size.width() * size.height() * 4;
+        IconFor(todo.at(i).win, *entry, saved_icon_size, CapturePool::PRIORITY_BACKGROUND);
+        entry->snapshot_pass = snapshot_passes;
+    }
+}
@@ -23,13 +23,21 @@ along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
 #include <xcb/xcb.h>
 #include <xcb/composite.h>
 #include <QList>
-#include <QMap>
+#include <QDateTime>
+#include <QByteArray>
+#include <functional>
 #include "wininfo.h"
+#include "windowregistry.h"
+#include "capturepool.h"
 
 class QBoxLayout;
 class QLabel;
 class xcbEventFilter;
+class XcbEventThread;
 class SettingsWindow;
+class ThumbnailCache;
+class PersistentThumbnails;
+class XcbReplyQueue;
 
 namespace Ui {
 class wmiib2;
@@ -58,30 +66,76 @@ private slots:
     void winResized(xcb_window_t win, const QSize &);
     void winIconified(xcb_window_t win);
     void winTitleChanged(xcb_window_t win, const QString &title);
+    void winIconChanged(xcb_window_t win);
     void DeiconifyWindow(xcb_window_t win);
     void SettingsChanged();
     void DelayedIconCreator();
+    void TakeSnapshots();
+    void iconReady(xcb_window_t win, quint32 generation, quint32 content, int icon_size, const QImage &icon, const WinInfo::IconFetch &icons);
+    void thumbnailLoaded(uint win, const QByteArray &identity, const QImage &icon);
 
 private:
     Ui::wmiib2 *ui;
     xcb_connection_t *connection;
     bool comp_version_ok, damg_version_ok;
     xcbEventFilter *evfilt;
-    QMap<xcb_window_t, WinInfo *> win_info;
-    QMap<xcb_window_t, QLabel *> win_icon;
+    XcbEventThread *evthread;
+    // everything we keep per client window
+    struct window_entry
+    {
+        window_entry() : icon(nullptr), unmapped(false), content(0), snapshot_taken(false), snapshot_content(0), snapshot_pass(0), snapshot_of_contents(false) { }
+        WinInfo info;
+        QLabel *icon;
+        // waiting out UNMAP_DESTROY_GRACE before it gets an icon
+        bool unmapped;
+        QDateTime unmap_deadline;
+        // bumped whenever what's on screen may have changed, so cached
+        // icons from before don't get used
+        quint32 content;
+        // the last background snapshot: which contents it was of and on
+        // which pass of the snapshot timer it was taken
+        bool snapshot_taken;
+        quint32 snapshot_content;
+        quint64 snapshot_pass;
+        // it's a picture of the window, taken or saved by the last run,
+        // rather than its icon or the default one
+        bool snapshot_of_contents;
+        // who the window belongs to, for the icons saved across restarts
+        QByteArray identity;
+    };
+    WindowRegistry<window_entry> windows;
+    int unmapped_count;
+    ThumbnailCache *thumbs;
+    CapturePool *captures;
+    PersistentThumbnails *saved;
+    // replies on Qt's connection that we don't want to sit and wait for
+    XcbReplyQueue *replies;
+    QPixmap placeholder;
     QBoxLayout *itemOuterLayout;
     QList<QBoxLayout *> itemInnerLayouts;
     SettingsWindow *setwin;
     void AdjustFrameSize(QWidgetList newWidgets = QWidgetList());
     void GenerateMask();
     void RemoveWindowIcon(xcb_window_t win);
+    void ClearUnmapped(window_entry &entry);
+    // only what an iconified window shows is worth keeping, since after a
+    // restart it's all there is of it
+    void SaveSnapshot(xcb_window_t win, const window_entry &entry, const QImage &icon);
+    // names the window's pixmap again without waiting for it, then calls
+    // then, unless the window has gone away by the time it's in
+    void RefreshPixmap(xcb_window_t win, const std::function<void(window_entry &)> &then = std::function<void(window_entry &)>());
+    // the cached icon, or a null pixmap and a capture on its way
+    QPixmap IconFor(xcb_window_t win, window_entry &entry, int icon_size, CapturePool::Priority priority, bool updatenwp = false);
+    // what a label shows until its icon is ready
+    QPixmap Placeholder(int icon_size);
     void AddWidgetToLayout(QLabel *newItem);
     void TryToShiftItemInLayout(int layoutIndex);
     int GetLayoutSize(int layoutIndex);
     int saved_icon_size;
     QPalette MyPalette;
-    QMap<xcb_window_t, QDateTime> unmapped_wins;
     QTimer *iTimer;
+    QTimer *sTimer;
+    quint64 snapshot_passes;
 };
 
 #endif // WMIIB2_H
@@ -29,7 +29,7 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 TARGET = wmiib2
 TEMPLATE = app
-LIBS += -lxcb -lxcb-composite -lxcb-damage
+LIBS += -lxcb -lxcb-composite -lxcb-damage -lxcb-shm -lxcb-render
 
 # The following define makes your compiler emit warnings if you use
 # any feature of Qt which has been marked as deprecated (the exact warnings
@@ -47,15 +47,47 @@ SOURCES += \
         main.cpp \
         wmiib2.cpp \
     xcbeventfilter.cpp \
+    xcbreplyqueue.cpp \
+    xcbeventthread.cpp \
     atomcache.cpp \
+    ewmhatoms.cpp \
+    logcategories.cpp \
     wininfo.cpp \
+    shmcapture.cpp \
+    capturecontext.cpp \
+    capturepool.cpp \
+    downscaler.cpp \
+    iconstore.cpp \
+    netwmicon.cpp \
+    persistentthumbnails.cpp \
+    pixelconvert.cpp \
+    renderscaler.cpp \
+    stripcapture.cpp \
+    thumbnailcache.cpp \
     settingswindow.cpp
 
 HEADERS += \
         wmiib2.h \
     xcbeventfilter.h \
+    xcbreplyqueue.h \
+    xcbeventthread.h \
+    spscring.h \
+    windowregistry.h \
     atomcache.h \
+    ewmhatoms.h \
+    logcategories.h \
     wininfo.h \
+    shmcapture.h \
+    capturecontext.h \
+    capturepool.h \
+    downscaler.h \
+    iconstore.h \
+    netwmicon.h \
+    persistentthumbnails.h \
+    pixelconvert.h \
+    renderscaler.h \
+    stripcapture.h \
+    thumbnailcache.h \
     settingswindow.h
 
 FORMS += \
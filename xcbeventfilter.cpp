@@ -17,19 +17,41 @@ You should have received a copy of the GNU General Public License
 along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include "xcbeventfilter.h"
-#include "atomcache.h"
+#include "xcbreplyqueue.h"
+#include "ewmhatoms.h"
+#include "logcategories.h"
 #include <xcb/xcb_event.h>
 #include <xcb/damage.h>
-#include <QX11Info>
 #include <QQueue>
+#include <QVector>
 #include <QDebug>
 
 QMutex xcbEventFilter::ut_mutex;
 xcb_timestamp_t xcbEventFilter::user_time = 1L;
 
-xcbEventFilter::xcbEventFilter() : QObject(nullptr)
+xcbEventFilter::xcbEventFilter(xcb_connection_t *c, bool private_connection) : QObject(nullptr),
+    connection(c), owns_connection(private_connection), damage_ok(false), damage_event_base(0), client_list_hint(0),
+    flush_queued(false), events_coalesced(0), events_merged(0), reported_merged(0)
 {
-    connection = QX11Info::connection();
+    replies = new XcbReplyQueue(connection, this);
+    if (owns_connection)
+    {
+        // nobody else is reading this connection, so events come to us from
+        // the same place the replies do
+        replies->SetEventHandler([this](xcb_generic_event_t *ev) {
+            static const QByteArray event_type("xcb_generic_event_t");
+            nativeEventFilter(event_type, ev, nullptr);
+        });
+    }
+}
+
+xcbEventFilter::~xcbEventFilter()
+{
+    if (owns_connection)
+    {
+        delete replies;
+        xcb_disconnect(connection);
+    }
 }
 
 void xcbEventFilter::Startup()
@@ -38,6 +60,21 @@ void xcbEventFilter::Startup()
     xcb_screen_iterator_t screen_iter = xcb_setup_roots_iterator(setup);
     int screen_count = xcb_setup_roots_length(setup);
     xcb_screen_t *screen;
+    // one round trip at startup is fine
+    const xcb_query_extension_reply_t *damage_ext = xcb_get_extension_data(connection, &xcb_damage_id);
+    if (damage_ext && damage_ext->present)
+    {
+        xcb_generic_error_t *err = nullptr;
+        xcb_damage_query_version_cookie_t dv_cookie = xcb_damage_query_version(connection, 1, 1);
+        xcb_damage_query_version_reply_t *dv_reply = xcb_damage_query_version_reply(connection, dv_cookie, &err);
+        if (dv_reply)
+        {
+            damage_ok = (dv_reply->major_version >= 1);
+            damage_event_base = damage_ext->first_event;
+            free(dv_reply);
+        }
+        errorHandler("xcbEventFilter::Startup: damage query_version", &err);
+    }
     // get root window client lists and set event masks
     // trying to go for a slightly smaller set of events here but we may need more
     uint32_t mask[] = { XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE };
@@ -53,7 +90,123 @@ void xcbEventFilter::Startup()
 
 void xcbEventFilter::GetClientListUpdate(xcb_window_t rootwin)
 {
-    static xcb_atom_t net_client_list = AtomCache::GetAtom("_NET_CLIENT_LIST");
+    // only the newest request for each root gets applied; anything older
+    // that's still in flight would just be out of date when it lands
+    quint64 serial = ++client_list_serial[rootwin];
+    RequestClientList(rootwin, serial, client_list_hint + 256);
+}
+
+void xcbEventFilter::RequestClientList(xcb_window_t rootwin, quint64 serial, uint32_t length)
+{
+    const xcb_atom_t net_client_list = EwmhAtoms::Get(EwmhAtoms::NET_CLIENT_LIST);
+    // ask for a bit more than the last list held, which is usually the whole
+    // thing.  if the server says there's more we ask again for all of it,
+    // so the list is never truncated no matter how big it gets.  not just
+    // for the rest: the list may have changed in between, and the rest of
+    // a different list glued onto this one would be neither.
+    xcb_get_property_cookie_t gp_cookie = xcb_get_property(connection, 0, rootwin, net_client_list, XCB_ATOM_WINDOW, 0, length);
+    replies->Expect(gp_cookie.sequence, [this, rootwin, serial](void *reply, xcb_generic_error_t *err) {
+        xcb_get_property_reply_t *prop_reply = static_cast<xcb_get_property_reply_t *>(reply);
+        if (!prop_reply)
+        {
+            qDebug() << "MenuXcbEventFilter: error getting client list replies";
+            if (!err) return;
+            switch (err->error_code)
+            {
+            case XCB_VALUE: qDebug() << "BadValue"; break;
+            case XCB_WINDOW: qDebug() << "BadWindow"; break;
+            case XCB_ATOM: qDebug() << "BadAtom"; break;
+            default: qDebug() << "UnknownError " << err->error_code;
+            }
+            xcb_value_error_t *verr = (xcb_value_error_t *)err;
+            qDebug() << "  Sequence:     " << verr->sequence;
+            qDebug() << "  Bad Value:    " << verr->bad_value;
+            qDebug() << "  Minor OpCode: " << verr->minor_opcode;
+            qDebug() << "  Major OpCode: " << verr->major_opcode;
+            qDebug() << "  Pad0:         " << verr->pad0;
+            free(err);
+            return;
+        }
+        free(err);
+        QVector<xcb_window_t> list;
+        uint32_t bytes_after = 0;
+        uint32_t received = 0;
+        if (prop_reply->type == XCB_ATOM_WINDOW && prop_reply->format == 32)
+        {
+            xcb_window_t *client_list = (xcb_window_t *)xcb_get_property_value(prop_reply);
+            int num_children = prop_reply->value_len;
+            list.reserve(num_children);
+            for (int i = 0; i < num_children; ++i) list.append(client_list[i]);
+            received = prop_reply->value_len;
+            bytes_after = prop_reply->bytes_after;
+        }
+        free(prop_reply);
+        if (serial != client_list_serial.value(rootwin)) return;
+        if (bytes_after)
+        {
+            RequestClientList(rootwin, serial, received + (bytes_after + 3) / 4);
+            return;
+        }
+        client_list_hint = list.count();
+        ApplyClientList(rootwin, list);
+    });
+}
+
+void xcbEventFilter::ApplyClientList(xcb_window_t rootwin, const QVector<xcb_window_t> &newcl)
+{
+    // diff against what this root listed last time using hashes so a big
+    // client list doesn't cost a quadratic scan on every change
+    QSet<xcb_window_t> newset;
+    newset.reserve(newcl.count());
+    QVector<xcb_window_t> added;
+    for (xcb_window_t win : newcl)
+    {
+        if (newset.contains(win)) continue;
+        newset.insert(win);
+        if (!clients.Contains(win)) added.append(win);
+    }
+    QQueue<xcb_window_t> removed;
+    QSet<xcb_window_t> &oldset = client_lists[rootwin];
+    for (xcb_window_t win : oldset)
+    {
+        if (!newset.contains(win)) removed.enqueue(win);
+    }
+    oldset = newset;
+    // find any new clients
+    // every request for every new window goes out together and the replies
+    // are collected when they've all arrived.  new clients sit in clients as
+    // placeholders until then so events for them aren't lost.
+    if (!added.isEmpty())
+    {
+        QVector<client_info::fetch_cookies> fetches;
+        fetches.reserve(added.count());
+        for (xcb_window_t new_client : added)
+        {
+            client_info &placeholder = clients.Insert(new_client);
+            placeholder.window = new_client;
+            placeholder.connection = connection;
+            placeholder.fetching = true;
+            fetches.append(client_info::SendFetch(connection, new_client));
+        }
+        replies->AfterPending([this, fetches]() { CollectNewClients(fetches); });
+    }
+    // and forget old clients that are gone
+    while (!removed.empty())
+    {
+        xcb_window_t old_client = removed.dequeue();
+        const client_info *old_info = clients.Find(old_client);
+        if (!old_info) continue;
+        bool do_emit = old_info->wtype_no_skip && !old_info->fetching;
+        xcb_window_t old_frame = old_info->frame;
+        if (old_frame && frame_clients.value(old_frame) == old_client) frame_clients.remove(old_frame);
+        if (old_info->damage) DestroyDamage(old_info->damage);
+        clients.Remove(old_client);
+        if (do_emit) emit WindowDestroyed(old_client);
+    }
+}
+
+void xcbEventFilter::CollectNewClients(const QVector<client_info::fetch_cookies> &fetches)
+{
     // this mask may be excessive
     //static uint32_t mask[] = { XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE };
     // let's try to lighten up...
@@ -61,143 +214,141 @@ void xcbEventFilter::GetClientListUpdate(xcb_window_t rootwin)
     // we never needed substructurenotify from what i can tell
     // so just property change, and really only for title/state
     static uint32_t mask[] = { XCB_EVENT_MASK_PROPERTY_CHANGE };
-    xcb_get_property_cookie_t gp_cookie = xcb_get_property(connection, 0, rootwin, net_client_list, XCB_ATOM_WINDOW, 0, BUFSIZ);
-    xcb_get_property_reply_t *prop_reply;
-    xcb_generic_error_t *err;
-    QList<xcb_window_t> newcl;
-    if ((prop_reply = xcb_get_property_reply(connection, gp_cookie, &err)))
+    QVector<xcb_window_t> added;
+    for (const client_info::fetch_cookies &fetch : fetches)
     {
-        if (prop_reply->type != XCB_ATOM_NONE)
+        // every reply has to be collected even if the window is already gone
+        client_info nc_info;
+        uint32_t your_event_mask = nc_info.CollectFetch(connection, fetch);
+        xcb_window_t new_client = fetch.window;
+        client_info *placeholder = clients.Find(new_client);
+        if (!(placeholder && placeholder->fetching)) continue;
+        nc_info.fetching = true;
+        *placeholder = nc_info;
+        IndexFrame(new_client, 0UL);
+        if (damage_ok)
         {
-            xcb_window_t *client_list = (xcb_window_t *)xcb_get_property_value(prop_reply);
-            int num_children = prop_reply->value_len;
-            for (int i = 0; i < num_children; ++i) newcl.append(client_list[i]);
+            // non-empty level only reports once until the damage is subtracted
+            placeholder->damage = xcb_generate_id(connection);
+            xcb_damage_create(connection, placeholder->damage, new_client, XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
         }
-        free(prop_reply);
-    }
-    else
-    {
-        qDebug() << "MenuXcbEventFilter: error getting client list replies";
-        switch (err->error_code)
+        added.append(new_client);
+        // request more events
+        // add to mask; don't replace it.
+        if ((your_event_mask & mask[0]) != mask[0])
         {
-        case XCB_VALUE: qDebug() << "BadValue"; break;
-        case XCB_WINDOW: qDebug() << "BadWindow"; break;
-        case XCB_ATOM: qDebug() << "BadAtom"; break;
-        default: qDebug() << "UnknownError " << err->error_code;
+            uint32_t newmask[] = { mask[0] };
+            newmask[0] |= your_event_mask;
+            xcb_change_window_attributes(connection, new_client, XCB_CW_EVENT_MASK, newmask);
         }
-        xcb_value_error_t *verr = (xcb_value_error_t *)err;
-        qDebug() << "  Sequence:     " << verr->sequence;
-        qDebug() << "  Bad Value:    " << verr->bad_value;
-        qDebug() << "  Minor OpCode: " << verr->minor_opcode;
-        qDebug() << "  Major OpCode: " << verr->major_opcode;
-        qDebug() << "  Pad0:         " << verr->pad0;
-        free(err);
     }
-    // find any new clients
-    for (int i = 0; i < newcl.count(); ++i)
+    if (added.isEmpty()) return;
+    // second batch: the frames' map states, which we couldn't ask about until now
+    struct frame_fetch
     {
-        xcb_window_t new_client = newcl.at(i);
-        if (!clients.contains(new_client))
+        xcb_window_t client, frame;
+        xcb_get_window_attributes_cookie_t cookie;
+    };
+    QVector<frame_fetch> frame_fetches;
+    for (xcb_window_t new_client : added)
+    {
+        const client_info *nc_info = clients.Find(new_client);
+        if (!nc_info->frame) continue;
+        frame_fetch ff;
+        ff.client = new_client;
+        ff.frame = nc_info->frame;
+        ff.cookie = nc_info->SendFrameState();
+        frame_fetches.append(ff);
+    }
+    replies->AfterPending([this, added, frame_fetches]() {
+        for (const frame_fetch &ff : frame_fetches)
         {
-            // add to clients
-            client_info nc_info(new_client);
-            clients[new_client] = nc_info;
-            // request more events
-            xcb_get_window_attributes_cookie_t gwa_cookie = xcb_get_window_attributes(connection, new_client);
-            // add to mask; don't replace it.
-            xcb_get_window_attributes_reply_t *gwa_reply = xcb_get_window_attributes_reply(connection, gwa_cookie, &err);
-            if (gwa_reply)
-            {
-                if ((gwa_reply->your_event_mask & mask[0]) != mask[0])
-                {
-                    uint32_t newmask[] = { mask[0] };
-                    newmask[0] |= gwa_reply->your_event_mask;
-                    xcb_change_window_attributes(connection, new_client, XCB_CW_EVENT_MASK, newmask);
-                }
-                free(gwa_reply);
-            }
+            xcb_generic_error_t *err = nullptr;
+            xcb_get_window_attributes_reply_t *ga_reply = xcb_get_window_attributes_reply(connection, ff.cookie, &err);
+            errorHandler("xcbEventFilter::CollectNewClients: get_window_attributes", &err);
+            client_info *nc_info = clients.Find(ff.client);
+            if (nc_info && nc_info->fetching && nc_info->frame == ff.frame) nc_info->ParseFrameState(ga_reply);
+            else free(ga_reply);
+        }
+        for (xcb_window_t new_client : added)
+        {
+            client_info *nc_ptr = clients.Find(new_client);
+            if (!(nc_ptr && nc_ptr->fetching)) continue;
+            client_info &nc_info = *nc_ptr;
+            nc_info.fetching = false;
             if (nc_info.wtype_no_skip)
             {
                 // emit signal
-                emit WindowMapped(new_client, clients[new_client].title);
+                emit WindowMapped(new_client, nc_info.title);
                 // and maybe another
-                if (clients[new_client].IsIconified()) emit WindowIconified(new_client);
+                if (nc_info.IsIconified())
+                {
+                    emit WindowIconified(new_client);
+                    TitleNeeded(new_client);
+                }
             }
         }
-    }
-    // find old clients that are gone
-    QMap<xcb_window_t, client_info>::iterator p;
-    QQueue<xcb_window_t> removed;
-    for (p = clients.begin(); p != clients.end(); ++p)
-    {
-        xcb_window_t old_client = p.key();
-        if (!newcl.contains(old_client)) removed.enqueue(old_client);
-    }
-    while (!removed.empty())
-    {
-        xcb_window_t old_client = removed.dequeue();
-        bool do_emit = clients[old_client].wtype_no_skip;
-        clients.remove(old_client);
-        if (do_emit) emit WindowDestroyed(old_client);
-    }
+    });
 }
 
 bool xcbEventFilter::nativeEventFilter(const QByteArray &eventType, void *message, long *)
 {
-    static xcb_atom_t net_wm_user_time = AtomCache::GetAtom("_NET_WM_USER_TIME");
-    static xcb_atom_t net_client_list = AtomCache::GetAtom("_NET_CLIENT_LIST");
-    static xcb_atom_t net_wm_name = AtomCache::GetAtom("_NET_WM_NAME");
-    static xcb_atom_t wm_name = AtomCache::GetAtom("WM_NAME");
-    static xcb_atom_t net_frame_window = AtomCache::GetAtom("_NET_FRAME_WINDOW");
-    static xcb_atom_t net_wm_state = AtomCache::GetAtom("_NET_WM_STATE");
-    static xcb_atom_t net_wm_window_type = AtomCache::GetAtom("_NET_WM_WINDOW_TYPE");
+    const xcb_atom_t net_wm_user_time = EwmhAtoms::Get(EwmhAtoms::NET_WM_USER_TIME);
+    const xcb_atom_t net_client_list = EwmhAtoms::Get(EwmhAtoms::NET_CLIENT_LIST);
+    const xcb_atom_t net_wm_name = EwmhAtoms::Get(EwmhAtoms::NET_WM_NAME);
+    const xcb_atom_t wm_name = EwmhAtoms::Get(EwmhAtoms::WM_NAME);
+    const xcb_atom_t net_frame_window = EwmhAtoms::Get(EwmhAtoms::NET_FRAME_WINDOW);
+    const xcb_atom_t net_wm_state = EwmhAtoms::Get(EwmhAtoms::NET_WM_STATE);
+    const xcb_atom_t net_wm_window_type = EwmhAtoms::Get(EwmhAtoms::NET_WM_WINDOW_TYPE);
+    const xcb_atom_t net_wm_icon = EwmhAtoms::Get(EwmhAtoms::NET_WM_ICON);
     if (eventType == "xcb_generic_event_t") {
         xcb_generic_event_t *ev = static_cast<xcb_generic_event_t *>(message);
+        // on Qt's connection its reader thread may have taken our replies off
+        // the socket before the notifier saw them, so any event is a good
+        // time to look.  on our own connection the queue is what's calling us.
+        if (!owns_connection && replies->Pending()) replies->Poll();
         xcb_map_notify_event_t *map_notify_ev;
         xcb_unmap_notify_event_t *unmap_notify_ev;
         xcb_configure_notify_event_t *configure_notify_ev;
         xcb_property_notify_event_t *property_notify_ev;
         xcb_damage_notify_event_t *damage_notify_ev;
         xcb_window_t cff_win;
+        client_info *info;
 
+        // damage events are numbered from wherever the server put the extension
+        if (damage_ok && (ev->response_type & ~0x80) == damage_event_base + XCB_DAMAGE_NOTIFY)
+        {
+            damage_notify_ev = (xcb_damage_notify_event_t *)ev;
+            if ((info = clients.Find(damage_notify_ev->drawable)) && info->damage == damage_notify_ev->damage)
+            {
+                // re-arm it and pass it on once per flush, however much gets drawn
+                xcb_damage_subtract(connection, info->damage, XCB_NONE, XCB_NONE);
+                if (info->wtype_no_skip) MarkDirty(damage_notify_ev->drawable, DIRTY_DAMAGE);
+            }
+            return false;
+        }
         switch (ev->response_type & ~0x80)
         {
         case XCB_UNMAP_NOTIFY:
             unmap_notify_ev = (xcb_unmap_notify_event_t *)ev;
             //qDebug() << "xcbEventFilter unmap event " << QString("0x%1").arg(unmap_notify_ev->window, 0, 16);
             // we're only concerned about frames because we're tracking _NET_WM_STATE
-            if ((cff_win = ClientForFrame(unmap_notify_ev->window)))
-            {
-                bool wasIcon = clients[cff_win].IsIconified();
-                clients[cff_win].GetFrameState();
-                if ((!wasIcon) && clients[cff_win].IsIconified())
-                {
-                    if (clients[cff_win].wtype_no_skip) emit WindowIconified(cff_win);
-                }
-            }
+            if ((cff_win = ClientForFrame(unmap_notify_ev->window))) RequestFrameState(cff_win, true);
             break;
         case XCB_MAP_NOTIFY:
             map_notify_ev = (xcb_map_notify_event_t *)ev;
             // we're only concerned about frames because we're tracking _NET_WM_STATE
-            if ((cff_win = ClientForFrame(map_notify_ev->window)))
-            {
-                bool wasIcon = clients[cff_win].IsIconified();
-                clients[cff_win].GetFrameState();
-                if (wasIcon && (!clients[cff_win].IsIconified()))
-                {
-                    if (clients[cff_win].wtype_no_skip) emit WindowMapped(cff_win, clients[cff_win].title);
-                }
-            }
+            if ((cff_win = ClientForFrame(map_notify_ev->window))) RequestFrameState(cff_win, true);
             break;
         case XCB_CONFIGURE_NOTIFY:
             configure_notify_ev = (xcb_configure_notify_event_t *)ev;
-            if (clients.contains(configure_notify_ev->window))
+            if ((info = clients.Find(configure_notify_ev->window)))
             {
                 QSize size(configure_notify_ev->width, configure_notify_ev->height);
-                if (size != clients[configure_notify_ev->window].size)
+                if (size != info->size)
                 {
-                    clients[configure_notify_ev->window].size = size;
-                    if (clients[configure_notify_ev->window].wtype_no_skip) emit WindowResized(configure_notify_ev->window, size);
+                    info->size = size;
+                    if (info->wtype_no_skip) MarkDirty(configure_notify_ev->window, DIRTY_SIZE);
                 }
             }
             break;
@@ -208,54 +359,32 @@ bool xcbEventFilter::nativeEventFilter(const QByteArray &eventType, void *messag
                 // The only root property I care about is _NET_CLIENT_LIST.
                 if (property_notify_ev->atom == net_client_list) GetClientListUpdate(property_notify_ev->window);
             }
-            else if (clients.contains(property_notify_ev->window))
+            else if (clients.Contains(property_notify_ev->window))
             {
                 // title change
                 if (property_notify_ev->atom == net_wm_name || property_notify_ev->atom == wm_name)
                 {
-                    if (clients[property_notify_ev->window].GetTitle() && clients[property_notify_ev->window].wtype_no_skip)
-                    {
-                        emit WindowTitleChanged(property_notify_ev->window, clients[property_notify_ev->window].title);
-                    }
+                    MarkDirty(property_notify_ev->window, DIRTY_TITLE);
                 }
                 // state change
                 else if (property_notify_ev->atom == net_wm_state)
                 {
-                    bool wasIcon = clients[property_notify_ev->window].IsIconified();
-                    clients[property_notify_ev->window].GetState();
-                    if (clients[property_notify_ev->window].wtype_no_skip)
-                    {
-                        if (!wasIcon)
-                        {
-                            if (clients[property_notify_ev->window].IsIconified()) emit WindowIconified(property_notify_ev->window);
-                        }
-                        else
-                        {
-                            if (!clients[property_notify_ev->window].IsIconified()) emit WindowMapped(property_notify_ev->window, clients[property_notify_ev->window].title);
-                        }
-                    }
+                    MarkDirty(property_notify_ev->window, DIRTY_STATE);
                 }
                 // frame change
                 else if (property_notify_ev->atom == net_frame_window)
                 {
-                    // frame added/removed should not change anything else of interest
-                    clients[property_notify_ev->window].GetFrame();
-                    clients[property_notify_ev->window].GetFrameState();
+                    RequestFrame(property_notify_ev->window);
                 }
                 // window type
                 else if (property_notify_ev->atom == net_wm_window_type)
                 {
-                    // window type changed
-                    bool old_wtype_nn = clients[property_notify_ev->window].wtype_no_skip;
-                    clients[property_notify_ev->window].GetWindowType();
-                    if (clients[property_notify_ev->window].wtype_no_skip)
-                    {
-                        if (!old_wtype_nn) emit WindowMapped(property_notify_ev->window, clients[property_notify_ev->window].title);
-                    }
-                    else
-                    {
-                        if (old_wtype_nn) emit WindowDestroyed(property_notify_ev->window);
-                    }
+                    RequestWindowType(property_notify_ev->window);
+                }
+                // icon
+                else if (property_notify_ev->atom == net_wm_icon)
+                {
+                    MarkDirty(property_notify_ev->window, DIRTY_ICON);
                 }
             }
             else if (property_notify_ev->atom == net_wm_user_time)
@@ -265,14 +394,6 @@ bool xcbEventFilter::nativeEventFilter(const QByteArray &eventType, void *messag
                 ut_mutex.unlock();
             }
             break;
-        case XCB_DAMAGE_NOTIFY:
-            damage_notify_ev = (xcb_damage_notify_event_t *)ev;
-            if (clients.contains(damage_notify_ev->drawable))
-            {
-                // toplevel window damage reported
-                if (clients[damage_notify_ev->drawable].wtype_no_skip) emit WindowDamaged(damage_notify_ev->drawable);
-            }
-            break;
         default:
             //qDebug() << "Unknown Event " << (ev->response_type & ~0x80) << AtomCache::GetAtomName(ev->response_type & ~0x80);
             break;
@@ -281,6 +402,252 @@ bool xcbEventFilter::nativeEventFilter(const QByteArray &eventType, void *messag
     return false;
 }
 
+void xcbEventFilter::RequestFrameState(xcb_window_t client, bool notify)
+{
+    // you don't actually get net_wm_state for the frame.
+    // you actually get the window attributes and look at the map state
+    const client_info *cinfo = clients.Find(client);
+    if (!(cinfo && cinfo->frame)) return;
+    xcb_window_t frame = cinfo->frame;
+    quint32 generation = clients.Generation(client);
+    xcb_get_window_attributes_cookie_t cookie = cinfo->SendFrameState();
+    replies->Expect(cookie.sequence, [this, client, generation, frame, notify](void *reply, xcb_generic_error_t *err) {
+        xcb_get_window_attributes_reply_t *ga_reply = static_cast<xcb_get_window_attributes_reply_t *>(reply);
+        errorHandler("xcbEventFilter::RequestFrameState", &err);
+        client_info *cinfo = clients.Find(client, generation);
+        if (!(cinfo && cinfo->frame == frame))
+        {
+            free(ga_reply);
+            return;
+        }
+        client_info &info = *cinfo;
+        bool wasIcon = info.IsIconified();
+        info.ParseFrameState(ga_reply);
+        if (!notify || info.fetching || !info.wtype_no_skip) return;
+        if ((!wasIcon) && info.IsIconified())
+        {
+            emit WindowIconified(client);
+            TitleNeeded(client);
+        }
+        else if (wasIcon && (!info.IsIconified())) emit WindowMapped(client, info.title);
+    });
+}
+
+void xcbEventFilter::RequestFrame(xcb_window_t client)
+{
+    quint32 generation = clients.Generation(client);
+    xcb_get_property_cookie_t cookie = client_info::RequestProperty(connection, client, EwmhAtoms::Get(EwmhAtoms::NET_FRAME_WINDOW), XCB_ATOM_WINDOW);
+    replies->Expect(cookie.sequence, [this, client, generation](void *reply, xcb_generic_error_t *err) {
+        xcb_get_property_reply_t *gp_reply = static_cast<xcb_get_property_reply_t *>(reply);
+        errorHandler("xcbEventFilter::RequestFrame: get property _NET_FRAME_WINDOW", &err);
+        client_info *info = clients.Find(client, generation);
+        if (!info)
+        {
+            free(gp_reply);
+            return;
+        }
+        // frame added/removed should not change anything else of interest
+        xcb_window_t old_frame = info->frame;
+        if (info->ParseFrame(gp_reply))
+        {
+            IndexFrame(client, old_frame);
+            RequestFrameState(client, false);
+        }
+    });
+}
+
+void xcbEventFilter::RequestWindowType(xcb_window_t client)
+{
+    quint32 generation = clients.Generation(client);
+    xcb_get_property_cookie_t cookie = client_info::RequestProperty(connection, client, EwmhAtoms::Get(EwmhAtoms::NET_WM_WINDOW_TYPE), XCB_ATOM_ATOM);
+    replies->Expect(cookie.sequence, [this, client, generation](void *reply, xcb_generic_error_t *err) {
+        xcb_get_property_reply_t *gp_reply = static_cast<xcb_get_property_reply_t *>(reply);
+        errorHandler("xcbEventFilter::RequestWindowType: get property _NET_WM_WINDOW_TYPE", &err);
+        client_info *cinfo = clients.Find(client, generation);
+        if (!cinfo)
+        {
+            free(gp_reply);
+            return;
+        }
+        // window type changed
+        client_info &info = *cinfo;
+        bool old_wtype_nn = info.wtype_no_skip;
+        info.ParseWindowType(gp_reply);
+        if (info.fetching) return;
+        if (info.wtype_no_skip)
+        {
+            if (!old_wtype_nn) emit WindowMapped(client, info.title);
+        }
+        else
+        {
+            if (old_wtype_nn) emit WindowDestroyed(client);
+        }
+    });
+}
+
+void xcbEventFilter::TitleNeeded(xcb_window_t client)
+{
+    // only windows that have (or are about to get) an icon need a title
+    const client_info *info = clients.Find(client);
+    if (info && info->title_stale && info->wtype_no_skip && !info->fetching && info->IsIconified()) RequestTitle(client);
+}
+
+void xcbEventFilter::RequestTitle(xcb_window_t client)
+{
+    client_info *cinfo = clients.Find(client);
+    // one at a time; if it goes stale again meanwhile the reply handler asks again
+    if (!cinfo || cinfo->title_fetching) return;
+    cinfo->title_stale = false;
+    cinfo->title_fetching = true;
+    quint32 generation = clients.Generation(client);
+    xcb_get_property_cookie_t net_wm_name = client_info::RequestProperty(connection, client, EwmhAtoms::Get(EwmhAtoms::NET_WM_NAME), EwmhAtoms::Get(EwmhAtoms::UTF8_STRING));
+    xcb_get_property_cookie_t wm_name = client_info::RequestProperty(connection, client, EwmhAtoms::Get(EwmhAtoms::WM_NAME), XCB_ATOM_ANY);
+    replies->AfterPending([this, client, generation, net_wm_name, wm_name]() {
+        xcb_generic_error_t *err = nullptr;
+        xcb_get_property_reply_t *net_wm_name_reply = xcb_get_property_reply(connection, net_wm_name, &err);
+        errorHandler("xcbEventFilter::RequestTitle: get property _NET_WM_NAME", &err);
+        xcb_get_property_reply_t *wm_name_reply = xcb_get_property_reply(connection, wm_name, &err);
+        errorHandler("xcbEventFilter::RequestTitle: get property WM_NAME", &err);
+        client_info *cinfo = clients.Find(client, generation);
+        if (!cinfo)
+        {
+            free(net_wm_name_reply);
+            free(wm_name_reply);
+            return;
+        }
+        client_info &info = *cinfo;
+        info.title_fetching = false;
+        if (info.ParseTitle(net_wm_name_reply, wm_name_reply) && info.wtype_no_skip && !info.fetching)
+        {
+            emit WindowTitleChanged(client, info.title);
+        }
+        TitleNeeded(client);
+    });
+}
+
+void xcbEventFilter::MarkDirty(xcb_window_t win, uint flag)
+{
+    // title, state, size and damage changes can come in floods (terminal titles,
+    // interactive resizes) so they're only recorded here and dealt with once
+    // per pass through the event loop by FlushDirty()
+    ++events_coalesced;
+    uint &flags = dirty[win];
+    if (flags & flag) ++events_merged;
+    flags |= flag;
+    if (!flush_queued)
+    {
+        flush_queued = true;
+        QMetaObject::invokeMethod(this, "FlushDirty", Qt::QueuedConnection);
+    }
+}
+
+void xcbEventFilter::DestroyDamage(xcb_damage_damage_t damage)
+{
+    // the window may already be gone and taken its damage with it, which is
+    // fine, so check quietly once it's been answered instead of letting the
+    // error show up as an event
+    xcb_void_cookie_t cookie = xcb_damage_destroy_checked(connection, damage);
+    replies->AfterPending([this, cookie]() {
+        free(xcb_request_check(connection, cookie));
+    });
+}
+
+void xcbEventFilter::FlushDirty()
+{
+    struct dirty_fetch
+    {
+        xcb_window_t window;
+        quint32 generation;
+        uint flags;
+        xcb_get_property_cookie_t state;
+    };
+    flush_queued = false;
+    QHash<xcb_window_t, uint> work;
+    work.swap(dirty);
+    // send everything now, collect it once it's all come back
+    QVector<dirty_fetch> fetches;
+    fetches.reserve(work.count());
+    for (QHash<xcb_window_t, uint>::const_iterator p = work.constBegin(); p != work.constEnd(); ++p)
+    {
+        client_info *info = clients.Find(p.key());
+        if (!info) continue;
+        dirty_fetch fetch;
+        fetch.window = p.key();
+        fetch.generation = clients.Generation(p.key());
+        fetch.flags = p.value();
+        if (fetch.flags & DIRTY_TITLE)
+        {
+            // titles are only shown for iconified windows; for everyone else
+            // it's enough to remember that ours is out of date
+            info->title_stale = true;
+            TitleNeeded(fetch.window);
+        }
+        if ((fetch.flags & DIRTY_DAMAGE) && info->wtype_no_skip && !info->fetching)
+        {
+            // nothing to ask the server about this one
+            emit WindowDamaged(fetch.window);
+        }
+        if ((fetch.flags & DIRTY_ICON) && info->wtype_no_skip && !info->fetching)
+        {
+            // nor this one, whoever shows the icon fetches it
+            emit WindowIconChanged(fetch.window);
+        }
+        if (fetch.flags & DIRTY_STATE)
+        {
+            fetch.state = client_info::RequestProperty(connection, fetch.window, EwmhAtoms::Get(EwmhAtoms::NET_WM_STATE), XCB_ATOM_ATOM);
+        }
+        fetches.append(fetch);
+    }
+    if (fetches.isEmpty()) return;
+    replies->AfterPending([this, fetches]() {
+        for (const dirty_fetch &fetch : fetches)
+        {
+            xcb_generic_error_t *err = nullptr;
+            xcb_get_property_reply_t *state_reply = nullptr;
+            if (fetch.flags & DIRTY_STATE)
+            {
+                state_reply = xcb_get_property_reply(connection, fetch.state, &err);
+                errorHandler("xcbEventFilter::FlushDirty: get property _NET_WM_STATE", &err);
+            }
+            client_info *cinfo = clients.Find(fetch.window, fetch.generation);
+            if (!cinfo)
+            {
+                free(state_reply);
+                continue;
+            }
+            client_info &info = *cinfo;
+            // new clients announce themselves once their own fetch is done
+            bool announce = info.wtype_no_skip && !info.fetching;
+            if (fetch.flags & DIRTY_STATE)
+            {
+                bool wasIcon = info.IsIconified();
+                info.ParseState(state_reply);
+                if (announce)
+                {
+                    if (!wasIcon)
+                    {
+                        if (info.IsIconified())
+                        {
+                            emit WindowIconified(fetch.window);
+                            TitleNeeded(fetch.window);
+                        }
+                    }
+                    else
+                    {
+                        if (!info.IsIconified()) emit WindowMapped(fetch.window, info.title);
+                    }
+                }
+            }
+            if ((fetch.flags & DIRTY_SIZE) && announce) emit WindowResized(fetch.window, info.size);
+        }
+    });
+    if ((events_merged / 1000) != (reported_merged / 1000))
+    {
+        qCDebug(lcStats) << "xcbEventFilter::FlushDirty:" << events_merged << "of" << events_coalesced << "events merged so far";
+        reported_merged = events_merged;
+    }
+}
+
 xcb_timestamp_t xcbEventFilter::GetUserTime()
 {
     ut_mutex.lock();
@@ -309,144 +676,118 @@ bool xcbEventFilter::errorHandler(const QString &prefix, xcb_generic_error_t **e
     return ret;
 }
 
-xcb_window_t xcbEventFilter::ClientForFrame(xcb_window_t win)
+xcb_window_t xcbEventFilter::ClientForFrame(xcb_window_t win) const
 {
-    QMap<xcb_window_t, client_info>::iterator p;
-    for (p = clients.begin(); p != clients.end(); ++p)
-    {
-        if (p.value().frame == win) return p.key();
-    }
-    return 0UL;
+    return frame_clients.value(win, 0UL);
+}
+
+void xcbEventFilter::IndexFrame(xcb_window_t client, xcb_window_t old_frame)
+{
+    // keep frame_clients in step with the client's frame
+    if (old_frame && frame_clients.value(old_frame) == client) frame_clients.remove(old_frame);
+    const client_info *info = clients.Find(client);
+    xcb_window_t new_frame = info ? info->frame : 0UL;
+    if (new_frame) frame_clients.insert(new_frame, client);
 }
 
 
 // ----------------( client_info )-------------------
 
-xcbEventFilter::client_info::client_info()
+xcbEventFilter::client_info::client_info() :
+    window(0UL), frame(0UL), damage(0UL), state_hidden(false), state_shaded(false),
+    frame_state_hidden(false), wtype_no_skip(false), fetching(false), title_stale(true),
+    title_fetching(false), connection(nullptr) { }
+
+xcb_get_property_cookie_t xcbEventFilter::client_info::RequestProperty(xcb_connection_t *c, xcb_window_t win, xcb_atom_t property, xcb_atom_t type)
 {
-    window = 0UL;
-    wtype_no_skip = false;
+    return xcb_get_property(c, 0, win, property, type, 0, BUFSIZ);
 }
 
-xcbEventFilter::client_info::client_info(const client_info &other) :
-    xcbEventFilter::client_info::client_info(other.window) { }
+xcbEventFilter::client_info::fetch_cookies xcbEventFilter::client_info::SendFetch(xcb_connection_t *c, xcb_window_t win)
+{
+    fetch_cookies cookies;
+    cookies.window = win;
+    cookies.geometry = xcb_get_geometry(c, win);
+    cookies.attributes = xcb_get_window_attributes(c, win);
+    cookies.state = RequestProperty(c, win, EwmhAtoms::Get(EwmhAtoms::NET_WM_STATE), XCB_ATOM_ATOM);
+    cookies.frame = RequestProperty(c, win, EwmhAtoms::Get(EwmhAtoms::NET_FRAME_WINDOW), XCB_ATOM_WINDOW);
+    cookies.window_type = RequestProperty(c, win, EwmhAtoms::Get(EwmhAtoms::NET_WM_WINDOW_TYPE), XCB_ATOM_ATOM);
+    return cookies;
+}
 
-xcbEventFilter::client_info::client_info(xcb_window_t win)
+uint32_t xcbEventFilter::client_info::CollectFetch(xcb_connection_t *c, const fetch_cookies &cookies)
 {
-    window = win;
-    if (!window) return;
-    connection = QX11Info::connection();
+    // replies have to be collected in the same order they were requested
+    window = cookies.window;
+    connection = c;
+    uint32_t your_event_mask = 0;
     xcb_generic_error_t *err = nullptr;
-    xcb_get_geometry_cookie_t gg_cookie = xcb_get_geometry(connection, win);
-    xcb_get_geometry_reply_t *gg_reply = xcb_get_geometry_reply(connection, gg_cookie, &err);
+    xcb_get_geometry_reply_t *gg_reply = xcb_get_geometry_reply(connection, cookies.geometry, &err);
     if (gg_reply)
     {
         size = QSize(gg_reply->width, gg_reply->height);
         free(gg_reply);
     }
-    if (err)
+    errorHandler("client_info::CollectFetch: get_geometry", &err);
+    xcb_get_window_attributes_reply_t *gwa_reply = xcb_get_window_attributes_reply(connection, cookies.attributes, &err);
+    if (gwa_reply)
     {
-        qDebug() << "client_info::client_info():get_geometry XCB Error " << err->error_code;
-        free(err);
+        your_event_mask = gwa_reply->your_event_mask;
+        free(gwa_reply);
     }
-    GetTitle();
-    GetState();
-    GetFrame();
-    GetFrameState();
-    GetWindowType();
+    errorHandler("client_info::CollectFetch: get_window_attributes", &err);
+    // the title isn't fetched until something wants it
+    title_stale = true;
+    ParseState(xcb_get_property_reply(connection, cookies.state, &err));
+    errorHandler("client_info::CollectFetch: get property _NET_WM_STATE", &err);
+    ParseFrame(xcb_get_property_reply(connection, cookies.frame, &err));
+    errorHandler("client_info::CollectFetch: get property _NET_FRAME_WINDOW", &err);
+    ParseWindowType(xcb_get_property_reply(connection, cookies.window_type, &err));
+    errorHandler("client_info::CollectFetch: get property _NET_WM_WINDOW_TYPE", &err);
+    return your_event_mask;
 }
 
-bool xcbEventFilter::client_info::GetTitle()
+bool xcbEventFilter::client_info::ParseTitle(xcb_get_property_reply_t *net_wm_name_reply, xcb_get_property_reply_t *wm_name_reply)
 {
-    static xcb_atom_t net_wm_name = AtomCache::GetAtom("_NET_WM_NAME");
-    static xcb_atom_t wm_name = AtomCache::GetAtom("WM_NAME");
-    static xcb_atom_t utf8_string = AtomCache::GetAtom("UTF8_STRING");
-    if (!window) return false;
-    xcb_generic_error_t *err = nullptr;
-    xcb_get_property_cookie_t gp_cookie;
-    xcb_get_property_reply_t *gp_reply;
+    const xcb_atom_t utf8_string = EwmhAtoms::Get(EwmhAtoms::UTF8_STRING);
     QString newTitle;
-    gp_cookie = xcb_get_property(connection, 0, window, net_wm_name, utf8_string, 0, BUFSIZ);
-    gp_reply = xcb_get_property_reply(connection, gp_cookie, &err);
-    if (gp_reply)
+    if (net_wm_name_reply)
     {
-        if (gp_reply->type == utf8_string)
+        if (net_wm_name_reply->type == utf8_string)
         {
-            const char *gp_utf8str = (const char *)xcb_get_property_value(gp_reply);
-            int gp_utf8str_len = xcb_get_property_value_length(gp_reply);
+            const char *gp_utf8str = (const char *)xcb_get_property_value(net_wm_name_reply);
+            int gp_utf8str_len = xcb_get_property_value_length(net_wm_name_reply);
             newTitle = QString::fromUtf8(gp_utf8str, gp_utf8str_len);
         }
-        free(gp_reply);
-    }
-    if (err)
-    {
-        qDebug() << "client_info::GetTitle:get property _NET_WM_NAME XCB Error " << err->error_code;
-        free(err);
-        err = nullptr;
-    }
-    if (!newTitle.isEmpty())
-    {
-        if (newTitle != title)
-        {
-            title = newTitle;
-            return true;
-        }
-        else return false;
+        free(net_wm_name_reply);
     }
-    gp_cookie = xcb_get_property(connection, 0, window, wm_name, XCB_ATOM_ANY, 0, BUFSIZ);
-    gp_reply = xcb_get_property_reply(connection, gp_cookie, &err);
-    if (gp_reply)
+    if (wm_name_reply)
     {
-        if (gp_reply->type != XCB_ATOM_NONE)
+        if (newTitle.isEmpty() && wm_name_reply->type != XCB_ATOM_NONE)
         {
-            const char *gp_utf8str = (const char *)xcb_get_property_value(gp_reply);
-            int gp_utf8str_len = xcb_get_property_value_length(gp_reply);
+            const char *gp_utf8str = (const char *)xcb_get_property_value(wm_name_reply);
+            int gp_utf8str_len = xcb_get_property_value_length(wm_name_reply);
             newTitle = QString::fromUtf8(gp_utf8str, gp_utf8str_len);
         }
-        free(gp_reply);
-    }
-    if (err)
-    {
-        qDebug() << "client_info::GetTitle:get property WM_NAME XCB Error " << err->error_code;
-        free(err);
-        err = nullptr;
-    }
-    if (!newTitle.isEmpty())
-    {
-        if (newTitle != title)
-        {
-            title = newTitle;
-            return true;
-        }
-        else return false;
+        free(wm_name_reply);
     }
-    if (title != "(no name)")
+    if (newTitle.isEmpty()) newTitle = "(no name)";
+    if (newTitle != title)
     {
-        title = "(no name)";
+        title = newTitle;
         return true;
     }
     return false;
 }
 
-bool xcbEventFilter::client_info::GetFrame()
+bool xcbEventFilter::client_info::ParseFrame(xcb_get_property_reply_t *gp_reply)
 {
-    static xcb_atom_t net_frame_window = AtomCache::GetAtom("_NET_FRAME_WINDOW");
-    if (!window) return false;
-    xcb_generic_error_t *err = nullptr;
     xcb_window_t newFrame = 0UL;
-    xcb_get_property_cookie_t gp_cookie = xcb_get_property(connection, 0, window, net_frame_window, XCB_ATOM_WINDOW, 0, BUFSIZ);
-    xcb_get_property_reply_t *gp_reply = xcb_get_property_reply(connection, gp_cookie, &err);
     if (gp_reply)
     {
-        if (gp_reply->type == XCB_ATOM_WINDOW) newFrame = *((xcb_window_t *)xcb_get_property_value(gp_reply));
+        if (gp_reply->type == XCB_ATOM_WINDOW && gp_reply->value_len >= 1) newFrame = *((xcb_window_t *)xcb_get_property_value(gp_reply));
         free(gp_reply);
     }
-    if (err)
-    {
-        qDebug() << "client_info::GetFrame:get property _NET_FRAME_WINDOW XCB Error " << err->error_code;
-        free(err);
-        err = nullptr;
-    }
     if (newFrame != frame)
     {
         frame = newFrame;
@@ -455,15 +796,10 @@ bool xcbEventFilter::client_info::GetFrame()
     return false;
 }
 
-void xcbEventFilter::client_info::GetState()
+void xcbEventFilter::client_info::ParseState(xcb_get_property_reply_t *gp_reply)
 {
-    static xcb_atom_t net_wm_state = AtomCache::GetAtom("_NET_WM_STATE");
-    static xcb_atom_t net_wm_state_hidden = AtomCache::GetAtom("_NET_WM_STATE_HIDDEN");
-    static xcb_atom_t net_wm_state_shaded = AtomCache::GetAtom("_NET_WM_STATE_SHADED");
-    if (!window) return;
-    xcb_generic_error_t *err = nullptr;
-    xcb_get_property_cookie_t gp_cookie = xcb_get_property(connection, 0, window, net_wm_state, XCB_ATOM_ATOM, 0, BUFSIZ);
-    xcb_get_property_reply_t *gp_reply = xcb_get_property_reply(connection, gp_cookie, &err);
+    const xcb_atom_t net_wm_state_hidden = EwmhAtoms::Get(EwmhAtoms::NET_WM_STATE_HIDDEN);
+    const xcb_atom_t net_wm_state_shaded = EwmhAtoms::Get(EwmhAtoms::NET_WM_STATE_SHADED);
     if (gp_reply)
     {
         state_hidden = false;
@@ -480,50 +816,31 @@ void xcbEventFilter::client_info::GetState()
         }
         free(gp_reply);
     }
-    if (err)
-    {
-        qDebug() << "client_info::GetState: XCB Error " << err->error_code;
-        free(err);
-        err = nullptr;
-    }
 }
 
-void xcbEventFilter::client_info::GetFrameState()
+xcb_get_window_attributes_cookie_t xcbEventFilter::client_info::SendFrameState() const
+{
+    return xcb_get_window_attributes(connection, frame);
+}
+
+void xcbEventFilter::client_info::ParseFrameState(xcb_get_window_attributes_reply_t *ga_reply)
 {
-    // you don't actually get net_wm_state for the frame.
-    // you actually get the window attributes and look at the map state
-    if (!frame) return;
-    xcb_generic_error_t *err = nullptr;
-    xcb_get_window_attributes_cookie_t ga_cookie = xcb_get_window_attributes(connection, frame);
-    xcb_get_window_attributes_reply_t *ga_reply = xcb_get_window_attributes_reply(connection, ga_cookie, &err);
     if (ga_reply)
     {
         frame_state_hidden = (ga_reply->map_state != XCB_MAP_STATE_VIEWABLE);
         free(ga_reply);
     }
-    if (err)
-    {
-        qDebug() << "client_info::GetFrameState: XCB Error " << err->error_code;
-        free(err);
-        err = nullptr;
-    }
 }
 
-void xcbEventFilter::client_info::GetWindowType()
+void xcbEventFilter::client_info::ParseWindowType(xcb_get_property_reply_t *gp_reply)
 {
-    static xcb_atom_t net_wm_window_type = AtomCache::GetAtom("_NET_WM_WINDOW_TYPE");
-    static xcb_atom_t net_wm_window_type_desktop = AtomCache::GetAtom("_NET_WM_WINDOW_TYPE_DESKTOP");
-    static xcb_atom_t net_wm_window_type_dock = AtomCache::GetAtom("_NET_WM_WINDOW_TYPE_DOCK");
-    static xcb_atom_t net_wm_window_type_toolbar = AtomCache::GetAtom("_NET_WM_WINDOW_TYPE_TOOLBAR");
-    static xcb_atom_t net_wm_window_type_menu = AtomCache::GetAtom("_NET_WM_WINDOW_TYPE_MENU");
-    static xcb_atom_t net_wm_window_type_utility = AtomCache::GetAtom("_NET_WM_WINDOW_TYPE_UTILITY");
-    static xcb_atom_t net_wm_window_type_splash = AtomCache::GetAtom("_NET_WM_WINDOW_TYPE_SPLASH");
-    static xcb_atom_t net_wm_window_type_dialog = AtomCache::GetAtom("_NET_WM_WINDOW_TYPE_DIALOG");
-    //static xcb_atom_t net_wm_window_type_normal = AtomCache::GetAtom("_NET_WM_WINDOW_TYPE_NORMAL");
-    if (!window) return;
-    xcb_generic_error_t *err = nullptr;
-    xcb_get_property_cookie_t gp_cookie = xcb_get_property(connection, 0, window, net_wm_window_type, XCB_ATOM_ATOM, 0, BUFSIZ);
-    xcb_get_property_reply_t *gp_reply = xcb_get_property_reply(connection, gp_cookie, &err);
+    const xcb_atom_t net_wm_window_type_desktop = EwmhAtoms::Get(EwmhAtoms::NET_WM_WINDOW_TYPE_DESKTOP);
+    const xcb_atom_t net_wm_window_type_dock = EwmhAtoms::Get(EwmhAtoms::NET_WM_WINDOW_TYPE_DOCK);
+    const xcb_atom_t net_wm_window_type_toolbar = EwmhAtoms::Get(EwmhAtoms::NET_WM_WINDOW_TYPE_TOOLBAR);
+    const xcb_atom_t net_wm_window_type_menu = EwmhAtoms::Get(EwmhAtoms::NET_WM_WINDOW_TYPE_MENU);
+    const xcb_atom_t net_wm_window_type_utility = EwmhAtoms::Get(EwmhAtoms::NET_WM_WINDOW_TYPE_UTILITY);
+    const xcb_atom_t net_wm_window_type_splash = EwmhAtoms::Get(EwmhAtoms::NET_WM_WINDOW_TYPE_SPLASH);
+    const xcb_atom_t net_wm_window_type_dialog = EwmhAtoms::Get(EwmhAtoms::NET_WM_WINDOW_TYPE_DIALOG);
     if (gp_reply)
     {
         wtype_no_skip = true;
@@ -544,17 +861,10 @@ void xcbEventFilter::client_info::GetWindowType()
                 {
                     wtype_no_skip = false;
                 }
-                //if (wtype_atoms[i] != net_wm_window_type_normal) wtype_normal_null = false;
             }
         }
         free(gp_reply);
     }
-    if (err)
-    {
-        qDebug() << "client_info::GetWindowType: XCB Error " << err->error_code;
-        free(err);
-        err = nullptr;
-    }
 }
 
 bool xcbEventFilter::client_info::IsIconified() const
@@ -562,5 +872,3 @@ bool xcbEventFilter::client_info::IsIconified() const
     if (!window) return false;
     return ((frame && frame_state_hidden) || ((!frame) && state_hidden));
 }
-
-
@@ -22,58 +22,118 @@ along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
 #include <QAbstractNativeEventFilter>
 #include <QObject>
 #include <QList>
-#include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QVector>
 #include <QSize>
 #include <QString>
 #include <QMutex>
 #include <xcb/xcb.h>
+#include <xcb/damage.h>
+#include "windowregistry.h"
+
+class XcbReplyQueue;
 
 class xcbEventFilter : public QObject, public QAbstractNativeEventFilter
 {
     Q_OBJECT
 public:
-    explicit xcbEventFilter();
+    // with private_connection the filter owns c, reads it itself and doesn't
+    // need to be installed into the application
+    explicit xcbEventFilter(xcb_connection_t *c, bool private_connection = false);
+    ~xcbEventFilter();
     bool nativeEventFilter(const QByteArray &eventType, void *message, long *) override;
     void GetClientListUpdate(xcb_window_t rootwin);
     static xcb_timestamp_t GetUserTime();
     static bool errorHandler(const QString &prefix, xcb_generic_error_t **errp);
+    quint64 EventsCoalesced() const { return events_coalesced; }
+    quint64 EventsMerged() const { return events_merged; }
 
 signals:
+    // titles are fetched lazily, so the one WindowMapped carries may be out of
+    // date; WindowTitleChanged follows once the window is iconified
     void WindowMapped(xcb_window_t, QString);
     void WindowDestroyed(xcb_window_t);
     void WindowIconified(xcb_window_t);
     void WindowDamaged(xcb_window_t);
     void WindowTitleChanged(xcb_window_t, QString);
     void WindowResized(xcb_window_t, QSize);
+    void WindowIconChanged(xcb_window_t);
 
 public slots:
     void Startup();
 
+private slots:
+    void FlushDirty();
+
 private:
     class client_info
     {
         friend class xcbEventFilter;
     public:
+        // plain value type: copying never talks to the server
         client_info();
-        client_info(const client_info &other);
     private:
-        client_info(xcb_window_t win);
-        bool GetTitle();
-        bool GetFrame();
-        void GetState();
-        void GetFrameState();
-        void GetWindowType();
+        // everything we ask the server about a new client, sent as one batch
+        struct fetch_cookies
+        {
+            xcb_window_t window;
+            xcb_get_geometry_cookie_t geometry;
+            xcb_get_window_attributes_cookie_t attributes;
+            xcb_get_property_cookie_t state, frame, window_type;
+        };
+        static fetch_cookies SendFetch(xcb_connection_t *c, xcb_window_t win);
+        uint32_t CollectFetch(xcb_connection_t *c, const fetch_cookies &cookies);
+        static xcb_get_property_cookie_t RequestProperty(xcb_connection_t *c, xcb_window_t win, xcb_atom_t property, xcb_atom_t type);
+        xcb_get_window_attributes_cookie_t SendFrameState() const;
+        bool ParseTitle(xcb_get_property_reply_t *net_wm_name_reply, xcb_get_property_reply_t *wm_name_reply);
+        bool ParseFrame(xcb_get_property_reply_t *gp_reply);
+        void ParseState(xcb_get_property_reply_t *gp_reply);
+        void ParseFrameState(xcb_get_window_attributes_reply_t *ga_reply);
+        void ParseWindowType(xcb_get_property_reply_t *gp_reply);
         bool IsIconified() const;
         QString title;
         QSize size;
         xcb_window_t window, frame;
+        // tells us when the contents change; 0 if damage isn't there
+        xcb_damage_damage_t damage;
         bool state_hidden, state_shaded, frame_state_hidden, wtype_no_skip;
+        // still waiting on the initial fetch; nothing gets announced until it's done
+        bool fetching;
+        // the title is only fetched for iconified windows; otherwise a title
+        // change just marks it stale
+        bool title_stale, title_fetching;
         xcb_connection_t *connection;
     };
-    xcb_window_t ClientForFrame(xcb_window_t win);
+    enum dirty_flags { DIRTY_TITLE = 0x1, DIRTY_STATE = 0x2, DIRTY_SIZE = 0x4, DIRTY_DAMAGE = 0x8, DIRTY_ICON = 0x10 };
+    xcb_window_t ClientForFrame(xcb_window_t win) const;
+    void IndexFrame(xcb_window_t client, xcb_window_t old_frame);
+    void RequestClientList(xcb_window_t rootwin, quint64 serial, uint32_t length);
+    void ApplyClientList(xcb_window_t rootwin, const QVector<xcb_window_t> &newcl);
+    void CollectNewClients(const QVector<client_info::fetch_cookies> &fetches);
+    void RequestFrameState(xcb_window_t client, bool notify);
+    void RequestFrame(xcb_window_t client);
+    void RequestWindowType(xcb_window_t client);
+    void TitleNeeded(xcb_window_t client);
+    void RequestTitle(xcb_window_t client);
+    void MarkDirty(xcb_window_t win, uint flag);
+    void DestroyDamage(xcb_damage_damage_t damage);
     xcb_connection_t *connection;
+    bool owns_connection;
+    // damage has to be initialized on every connection that uses it, and its
+    // events come in above the core ones
+    bool damage_ok;
+    uint8_t damage_event_base;
     QList<xcb_window_t> root_wins;
-    QMap<xcb_window_t, client_info> clients;
+    WindowRegistry<client_info> clients;
+    QHash<xcb_window_t, xcb_window_t> frame_clients;
+    QHash<xcb_window_t, QSet<xcb_window_t> > client_lists;
+    QHash<xcb_window_t, quint64> client_list_serial;
+    uint32_t client_list_hint;
+    XcbReplyQueue *replies;
+    QHash<xcb_window_t, uint> dirty;
+    bool flush_queued;
+    quint64 events_coalesced, events_merged, reported_merged;
     static QMutex ut_mutex;
     static xcb_timestamp_t user_time;
 };
@@ -0,0 +1,160 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "xcbeventthread.h"
+#include "xcbeventfilter.h"
+#include <QThread>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QDebug>
+
+XcbEventThread::XcbEventThread(QObject *parent) :
+    QObject(parent), thread(nullptr), filter(nullptr), wake_queued(false), producer_waiting(false)
+{
+    // same $DISPLAY Qt itself connected to
+    xcb_connection_t *c = xcb_connect(nullptr, nullptr);
+    if (xcb_connection_has_error(c))
+    {
+        qDebug() << "XcbEventThread: couldn't open a second connection to the X server";
+        xcb_disconnect(c);
+        return;
+    }
+    filter = new xcbEventFilter(c, true);
+    connect(filter, SIGNAL(WindowMapped(xcb_window_t,QString)), this, SLOT(QueueMapped(xcb_window_t,QString)), Qt::DirectConnection);
+    connect(filter, SIGNAL(WindowDestroyed(xcb_window_t)), this, SLOT(QueueDestroyed(xcb_window_t)), Qt::DirectConnection);
+    connect(filter, SIGNAL(WindowIconified(xcb_window_t)), this, SLOT(QueueIconified(xcb_window_t)), Qt::DirectConnection);
+    connect(filter, SIGNAL(WindowDamaged(xcb_window_t)), this, SLOT(QueueDamaged(xcb_window_t)), Qt::DirectConnection);
+    connect(filter, SIGNAL(WindowResized(xcb_window_t,QSize)), this, SLOT(QueueResized(xcb_window_t,QSize)), Qt::DirectConnection);
+    connect(filter, SIGNAL(WindowTitleChanged(xcb_window_t,QString)), this, SLOT(QueueTitleChanged(xcb_window_t,QString)), Qt::DirectConnection);
+    connect(filter, SIGNAL(WindowIconChanged(xcb_window_t)), this, SLOT(QueueIconChanged(xcb_window_t)), Qt::DirectConnection);
+    thread = new QThread(this);
+    filter->moveToThread(thread);
+    // the filter has to go away on its own thread since it owns socket notifiers
+    connect(thread, SIGNAL(finished()), filter, SLOT(deleteLater()));
+}
+
+XcbEventThread::~XcbEventThread()
+{
+    if (!thread) return;
+    // anything still waiting for room gives up instead of waiting on us forever
+    thread->requestInterruption();
+    thread->quit();
+    thread->wait();
+}
+
+void XcbEventThread::Start()
+{
+    if (!filter) return;
+    thread->start();
+    QMetaObject::invokeMethod(filter, "Startup", Qt::QueuedConnection);
+}
+
+void XcbEventThread::QueueMapped(xcb_window_t win, const QString &title)
+{
+    window_delta delta(window_delta::MAPPED, win);
+    delta.title = title;
+    Queue(delta);
+}
+
+void XcbEventThread::QueueDestroyed(xcb_window_t win)
+{
+    Queue(window_delta(window_delta::DESTROYED, win));
+}
+
+void XcbEventThread::QueueIconified(xcb_window_t win)
+{
+    Queue(window_delta(window_delta::ICONIFIED, win));
+}
+
+void XcbEventThread::QueueDamaged(xcb_window_t win)
+{
+    Queue(window_delta(window_delta::DAMAGED, win));
+}
+
+void XcbEventThread::QueueTitleChanged(xcb_window_t win, const QString &title)
+{
+    window_delta delta(window_delta::TITLE_CHANGED, win);
+    delta.title = title;
+    Queue(delta);
+}
+
+void XcbEventThread::QueueResized(xcb_window_t win, const QSize &size)
+{
+    window_delta delta(window_delta::RESIZED, win);
+    delta.size = size;
+    Queue(delta);
+}
+
+void XcbEventThread::QueueIconChanged(xcb_window_t win)
+{
+    Queue(window_delta(window_delta::ICON_CHANGED, win));
+}
+
+void XcbEventThread::Queue(const window_delta &delta)
+{
+    if (ring.Push(delta))
+    {
+        Wake();
+        return;
+    }
+    // deltas can't just be dropped, so if the gui has fallen this far behind
+    // all we can do is make sure it's been woken and sleep until it catches up
+    QMutexLocker locker(&room_mutex);
+    producer_waiting.store(true);
+    while (!ring.Push(delta))
+    {
+        // unless we're shutting down, in which case nobody's listening
+        if (thread->isInterruptionRequested()) break;
+        Wake();
+        // the timeout covers a wakeup that slips past producer_waiting
+        room.wait(&room_mutex, 100);
+    }
+    producer_waiting.store(false);
+    Wake();
+}
+
+void XcbEventThread::Wake()
+{
+    // one queued Drain() covers everything pushed before it runs
+    if (!wake_queued.exchange(true)) QMetaObject::invokeMethod(this, "Drain", Qt::QueuedConnection);
+}
+
+void XcbEventThread::Drain()
+{
+    // clear the flag first: anything pushed after this point queues a new Drain()
+    wake_queued.store(false);
+    window_delta delta;
+    while (ring.Pop(delta))
+    {
+        switch (delta.type)
+        {
+        case window_delta::MAPPED: emit WindowMapped(delta.window, delta.title); break;
+        case window_delta::DESTROYED: emit WindowDestroyed(delta.window); break;
+        case window_delta::ICONIFIED: emit WindowIconified(delta.window); break;
+        case window_delta::DAMAGED: emit WindowDamaged(delta.window); break;
+        case window_delta::TITLE_CHANGED: emit WindowTitleChanged(delta.window, delta.title); break;
+        case window_delta::RESIZED: emit WindowResized(delta.window, delta.size); break;
+        case window_delta::ICON_CHANGED: emit WindowIconChanged(delta.window); break;
+        }
+    }
+    if (producer_waiting.load())
+    {
+        QMutexLocker locker(&room_mutex);
+        room.wakeAll();
+    }
+}
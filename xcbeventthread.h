@@ -0,0 +1,94 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef XCBEVENTTHREAD_H
+#define XCBEVENTTHREAD_H
+
+#include <QObject>
+#include <QString>
+#include <QSize>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <xcb/xcb.h>
+#include "spscring.h"
+
+class QThread;
+class xcbEventFilter;
+
+// Runs an xcbEventFilter on its own thread with its own connection to the
+// server, so X traffic keeps moving while the gui is busy (and the other way
+// around).  The filter's signals are packed into window_delta records, passed
+// over a lock free ring, and re-emitted here on the gui thread with the same
+// signatures the filter has.
+class XcbEventThread : public QObject
+{
+    Q_OBJECT
+public:
+    explicit XcbEventThread(QObject *parent = nullptr);
+    ~XcbEventThread();
+    // false if we couldn't get our own connection
+    bool IsValid() const { return filter != nullptr; }
+    void Start();
+
+signals:
+    void WindowMapped(xcb_window_t, QString);
+    void WindowDestroyed(xcb_window_t);
+    void WindowIconified(xcb_window_t);
+    void WindowDamaged(xcb_window_t);
+    void WindowTitleChanged(xcb_window_t, QString);
+    void WindowResized(xcb_window_t, QSize);
+    void WindowIconChanged(xcb_window_t);
+
+private slots:
+    // these get called directly on the event thread
+    void QueueMapped(xcb_window_t win, const QString &title);
+    void QueueDestroyed(xcb_window_t win);
+    void QueueIconified(xcb_window_t win);
+    void QueueDamaged(xcb_window_t win);
+    void QueueTitleChanged(xcb_window_t win, const QString &title);
+    void QueueResized(xcb_window_t win, const QSize &size);
+    void QueueIconChanged(xcb_window_t win);
+    // and this one on the gui thread
+    void Drain();
+
+private:
+    struct window_delta
+    {
+        enum delta_type { MAPPED, DESTROYED, ICONIFIED, DAMAGED, TITLE_CHANGED, RESIZED, ICON_CHANGED };
+        window_delta() : type(DAMAGED), window(0) { }
+        window_delta(delta_type t, xcb_window_t win) : type(t), window(win) { }
+        delta_type type;
+        xcb_window_t window;
+        QString title;
+        QSize size;
+    };
+    void Queue(const window_delta &delta);
+    void Wake();
+    QThread *thread;
+    xcbEventFilter *filter;
+    SpscRing<window_delta, 4096> ring;
+    std::atomic<bool> wake_queued;
+    // only for when the ring is full: the event thread sleeps on room until
+    // Drain() has made some
+    QMutex room_mutex;
+    QWaitCondition room;
+    std::atomic<bool> producer_waiting;
+};
+
+#endif // XCBEVENTTHREAD_H
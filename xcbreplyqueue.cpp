@@ -0,0 +1,134 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "xcbreplyqueue.h"
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QThread>
+#include <QCoreApplication>
+#include <QDebug>
+#include <xcb/xcbext.h>
+#include <cstdlib>
+
+// how long to wait before looking again if nothing else woke us, in msec.
+// on Qt's connection a reply Qt's reader thread already took off the socket
+// wakes neither the notifier nor, if no event follows it, the event filter,
+// so this is all that's left.  about a frame, so a continuation that ends in
+// something on screen isn't visibly late, and it only runs while anything
+// is outstanding.
+#define REPLY_SAFETY_POLL 16
+
+XcbReplyQueue::XcbReplyQueue(xcb_connection_t *c, QObject *parent) :
+    QObject(parent), connection(c), filtering(false)
+{
+    // the socket tells us when something new comes in.  on Qt's connection
+    // its own reader thread can get to the socket first, in which case every
+    // event Qt hands out is a chance to look (see nativeEventFilter()), and
+    // as a last resort a timer runs while anything is outstanding.
+    notifier = new QSocketNotifier(xcb_get_file_descriptor(connection), QSocketNotifier::Read, this);
+    connect(notifier, SIGNAL(activated(int)), this, SLOT(Poll()));
+    poll_timer = new QTimer(this);
+    connect(poll_timer, SIGNAL(timeout()), this, SLOT(Poll()));
+}
+
+void XcbReplyQueue::Expect(unsigned int sequence, const Continuation &fn)
+{
+    // a connection with an event handler is ours alone and nothing Qt sees
+    // has anything to do with it.  filters live on the gui thread, and
+    // QAbstractNativeEventFilter takes itself out again when we're deleted.
+    QCoreApplication *app = QCoreApplication::instance();
+    if (!filtering && !event_handler && app && QThread::currentThread() == app->thread())
+    {
+        app->installNativeEventFilter(this);
+        filtering = true;
+    }
+    pending_reply pr;
+    pr.sequence = sequence;
+    pr.fn = fn;
+    pending.enqueue(pr);
+    // first poll (and flush) on the next pass through the event loop so that
+    // everything sent during this one goes out together
+    if (!poll_timer->isActive() || poll_timer->interval() != 0) poll_timer->start(0);
+}
+
+void XcbReplyQueue::AfterPending(const std::function<void()> &fn)
+{
+    // get_input_focus is about the cheapest request there is with a reply.
+    // replies come back in order, so once it's answered, so is everything before it.
+    xcb_get_input_focus_cookie_t cookie = xcb_get_input_focus(connection);
+    Expect(cookie.sequence, [fn](void *reply, xcb_generic_error_t *err) {
+        free(reply);
+        free(err);
+        fn();
+    });
+}
+
+void XcbReplyQueue::SetEventHandler(const EventHandler &fn)
+{
+    event_handler = fn;
+    if (filtering)
+    {
+        QCoreApplication::instance()->removeNativeEventFilter(this);
+        filtering = false;
+    }
+}
+
+bool XcbReplyQueue::nativeEventFilter(const QByteArray &eventType, void *, long *)
+{
+    // only ever polls for what's pending, so this is cheap enough to do on
+    // every event.  the event itself is left for whoever wants it.
+    if (!pending.isEmpty() && eventType == "xcb_generic_event_t") Poll();
+    return false;
+}
+
+void XcbReplyQueue::Poll()
+{
+    xcb_flush(connection);
+    while (!pending.isEmpty())
+    {
+        void *reply = nullptr;
+        xcb_generic_error_t *err = nullptr;
+        if (!xcb_poll_for_reply(connection, pending.head().sequence, &reply, &err)) break;
+        // a continuation may queue more requests, so take it off first
+        pending_reply pr = pending.dequeue();
+        pr.fn(reply, err);
+    }
+    if (event_handler)
+    {
+        // polling for replies reads whatever is on the socket, events included,
+        // and those won't wake the notifier again.  so hand them out here.
+        xcb_generic_event_t *ev;
+        while ((ev = xcb_poll_for_event(connection)))
+        {
+            event_handler(ev);
+            free(ev);
+        }
+        if (xcb_connection_has_error(connection))
+        {
+            qDebug() << "XcbReplyQueue::Poll: connection to the X server lost";
+            notifier->setEnabled(false);
+            poll_timer->stop();
+            return;
+        }
+    }
+    // from here on it's the socket's job to wake us
+    if (pending.isEmpty()) poll_timer->stop();
+    else if (!poll_timer->isActive() || poll_timer->interval() == 0) poll_timer->start(REPLY_SAFETY_POLL);
+    // anything the continuations sent needs to go out too
+    xcb_flush(connection);
+}
@@ -0,0 +1,71 @@
+/*
+Copyright 2019 Reuben Robert Shaffer II.  All rights reserved.
+
+This file is part of WMIIB2.
+
+WMIIB2 is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+WMIIB2 is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with WMIIB2.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef XCBREPLYQUEUE_H
+#define XCBREPLYQUEUE_H
+
+#include <QObject>
+#include <QAbstractNativeEventFilter>
+#include <QQueue>
+#include <functional>
+#include <xcb/xcb.h>
+
+class QSocketNotifier;
+class QTimer;
+
+// Collects replies without ever blocking on the X server.  A request's cookie
+// sequence is registered together with a continuation, and the continuation
+// runs once xcb_poll_for_reply() says the reply (or error) is in.  The
+// continuation owns the reply and the error and must free them.
+// On Qt's connection it also looks for replies after every X event Qt hands
+// out, since Qt's reader thread may have taken them off the socket already.
+class XcbReplyQueue : public QObject, public QAbstractNativeEventFilter
+{
+    Q_OBJECT
+public:
+    typedef std::function<void(void *reply, xcb_generic_error_t *err)> Continuation;
+    typedef std::function<void(xcb_generic_event_t *ev)> EventHandler;
+    explicit XcbReplyQueue(xcb_connection_t *c, QObject *parent = nullptr);
+    void Expect(unsigned int sequence, const Continuation &fn);
+    // runs fn once every request sent before this call has been answered,
+    // so fn can collect any of their replies with xcb_*_reply() without waiting
+    void AfterPending(const std::function<void()> &fn);
+    int Pending() const { return pending.count(); }
+    // only for a connection nobody else reads: every poll also hands any
+    // queued events to fn (which must not free them)
+    void SetEventHandler(const EventHandler &fn);
+    bool nativeEventFilter(const QByteArray &eventType, void *message, long *) override;
+
+public slots:
+    void Poll();
+
+private:
+    struct pending_reply
+    {
+        unsigned int sequence;
+        Continuation fn;
+    };
+    xcb_connection_t *connection;
+    QQueue<pending_reply> pending;
+    EventHandler event_handler;
+    QSocketNotifier *notifier;
+    QTimer *poll_timer;
+    bool filtering;
+};
+
+#endif // XCBREPLYQUEUE_H